@@ -0,0 +1,172 @@
+/*
+ *   Example file for NiCMidi - A C++ Class Library for MIDI
+ *
+ *   Copyright (C) 2021, 2022  Nicola Cassetta
+ *   https://github.com/ncassetta/NiCMidi
+ *
+ *   This file is part of NiCMidi.
+ *
+ *   NiCMidi is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   NiCMidi is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with NiCMidi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+  A simple program which tests the MIDIJackOutDriver class in sync mode: a
+  MIDISequencer plays regularly spaced notes through the driver, whose port is
+  connected to a second JACK client opened by the program. This records the
+  absolute frame of every Note On received and at the end the program prints
+  the frame offsets inside the periods and the error of the intervals between
+  the notes (which should be 0 in sync mode).
+  You need a running JACK server: you can start one with the dummy backend
+  (jackd -d dummy).
+*/
+
+
+#include "../include/manager.h"
+#include "../include/sequencer.h"
+#include "../include/jackdriver.h"
+
+#include <iostream>
+#include <atomic>
+
+using namespace std;
+
+
+#ifdef __UNIX_JACK__
+
+const unsigned int NUM_NOTES = 64;
+const MIDIClockTime NOTE_STEP = DEFAULT_CLKS_PER_BEAT / 4;     // sixteenths (125 msecs at 120 bpm)
+const unsigned int MAX_RECEIVED = 256;
+
+jack_port_t* in_port;
+jack_nframes_t received[MAX_RECEIVED];      // written only by the JACK thread
+atomic<unsigned int> num_received(0);
+
+
+// The process callback of the receiving client: records the absolute frame of every Note On
+int ReceiveCallback(jack_nframes_t nframes, void* arg) {
+    jack_client_t* client = (jack_client_t*)arg;
+    void* buffer = jack_port_get_buffer(in_port, nframes);
+    jack_nframes_t cycle_start = jack_last_frame_time(client);
+    unsigned int count = jack_midi_get_event_count(buffer);
+    for (unsigned int i = 0; i < count; i++) {
+        jack_midi_event_t ev;
+        if (jack_midi_event_get(&ev, buffer, i) != 0)
+            continue;
+        if (ev.size == 3 && (ev.buffer[0] & 0xf0) == 0x90 && ev.buffer[2] != 0) {
+            unsigned int n = num_received.load();
+            if (n < MAX_RECEIVED) {
+                received[n] = cycle_start + ev.time;
+                num_received.store(n + 1);
+            }
+        }
+    }
+    return 0;
+}
+
+
+int main() {
+    // the driver is created in sync mode: the sequencer will run in the JACK thread
+    MIDIJackOutDriver* driver = new MIDIJackOutDriver(MIDIManager::GetNumMIDIOuts(), "NiCMidi", true);
+    MIDIManager::AddOutDriver(driver);
+    driver->OpenPort();
+    if (!driver->IsPortOpen()) {
+        cout << "Cannot open the JACK driver (is jackd running?)" << endl;
+        return EXIT_FAILURE;
+    }
+
+    // opens the receiving client and connects it to the driver port
+    jack_client_t* client = jack_client_open("NiCMidi_test", JackNoStartServer, 0);
+    if (!client) {
+        cout << "Cannot open the receiving JACK client" << endl;
+        return EXIT_FAILURE;
+    }
+    in_port = jack_port_register(client, "midi_in", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
+    jack_set_process_callback(client, ReceiveCallback, client);
+    if (!in_port || jack_activate(client) != 0 ||
+        jack_connect(client, driver->GetPortName().c_str(), jack_port_name(in_port)) != 0) {
+        cout << "Cannot connect the JACK ports" << endl;
+        jack_client_close(client);
+        return EXIT_FAILURE;
+    }
+    jack_nframes_t sample_rate = jack_get_sample_rate(client);
+    jack_nframes_t period = jack_get_buffer_size(client);
+
+    // builds a multitrack with regularly spaced notes on track 1
+    MIDIMultiTrack multitrack(2);
+    MIDITimedMessage msg;
+    for (unsigned int i = 0; i < NUM_NOTES; i++) {
+        msg.SetNoteOn(0, 60 + i % 12, 100);
+        msg.SetTime(i * NOTE_STEP);
+        multitrack.InsertNote(1, msg, NOTE_STEP / 2);
+    }
+    multitrack.GetTrack(1)->SetOutPort(driver->GetPortId());
+
+    MIDISequencer sequencer(&multitrack);
+    MIDIManager::AddMIDITick(&sequencer);
+    cout << "Playing " << NUM_NOTES << " notes (sample rate " << sample_rate << ", period "
+         << period << " frames) ..." << endl;
+    sequencer.Play();
+    while (sequencer.IsPlaying())
+        MIDITimer::Wait(50);
+    MIDITimer::Wait(200);
+    jack_deactivate(client);
+
+    unsigned int n = num_received.load();
+    cout << endl << "Received " << n << " notes of " << NUM_NOTES << ", " << driver->GetNumLost()
+         << " messages lost by the driver" << endl;
+    if (n < 2) {
+        jack_client_close(client);
+        driver->ClosePort();
+        return EXIT_FAILURE;
+    }
+
+    // the offsets of the notes inside their period
+    unsigned int offsets_zero = 0;
+    cout << "Frame offsets inside the period:";
+    for (unsigned int i = 0; i < n; i++) {
+        if (i % 16 == 0)
+            cout << endl << "    ";
+        cout << received[i] % period << " ";
+        if (received[i] % period == 0)
+            offsets_zero++;
+    }
+    cout << endl << offsets_zero << " notes at the start of the period" << endl;
+
+    // the error of the intervals between the notes
+    double expected = 60.0 / 120.0 * NOTE_STEP / DEFAULT_CLKS_PER_BEAT * sample_rate;
+    double max_err = 0.0, sum_err = 0.0;
+    for (unsigned int i = 1; i < n; i++) {
+        double err = (double)(received[i] - received[i - 1]) - expected;
+        if (err < 0.0)
+            err = -err;
+        sum_err += err;
+        if (err > max_err)
+            max_err = err;
+    }
+    cout << "Interval between notes: expected " << expected << " frames, error average "
+         << sum_err / (n - 1) << " frames, max " << max_err << " frames" << endl;
+
+    jack_client_close(client);
+    driver->ClosePort();
+    return n == NUM_NOTES ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#else
+
+int main() {
+    cout << "JACK support not compiled: configure the library with the JACK development files installed" << endl;
+    return EXIT_FAILURE;
+}
+
+#endif // __UNIX_JACK__
@@ -0,0 +1,190 @@
+/*
+ *   Example file for NiCMidi - A C++ Class Library for MIDI
+ *
+ *   Copyright (C) 2021, 2022  Nicola Cassetta
+ *   https://github.com/ncassetta/NiCMidi
+ *
+ *   This file is part of NiCMidi.
+ *
+ *   NiCMidi is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   NiCMidi is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with NiCMidi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+  A simple program which tests the MIDIShmOutDriver and MIDIShmInDriver classes
+  with two processes: it forks a consumer, which opens a MIDIShmInDriver, and
+  then the publisher sends through a MIDIShmOutDriver sysex messages carrying
+  their send time (half of them longer than a ring record, so they are split
+  over many records). The consumer checks every message with a MIDIProcessor,
+  which is called by the reading thread as soon as it gets it, and at the end
+  prints the received messages and the latency.
+*/
+
+
+#include "../include/manager.h"
+#include "../include/shmdriver.h"
+
+#include <iostream>
+#include <chrono>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+const char SHM_NAME[] = "/nicmidi_test";
+const unsigned int NUM_MESSAGES = 1000;
+const unsigned int SHORT_LEN = 16;
+const unsigned int LONG_LEN = 300;          // more than 5 records
+const unsigned int TIME_BYTES = 10;         // 7 bits each
+
+
+// the time in nsecs, common to all the processes
+long long GetTimeNs() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// Checks the received messages and computes the latency
+class LatencyMeter : public MIDIProcessor {
+    public:
+                        LatencyMeter()                  { Reset(); }
+        virtual void    Reset()                         { num_received = num_long = num_bad = 0;
+                                                          sum_latency = max_latency = 0; }
+        virtual bool    Process(MIDITimedMessage* msg);
+
+        unsigned int    num_received;
+        unsigned int    num_long;
+        unsigned int    num_bad;
+        long long       sum_latency;
+        long long       max_latency;
+};
+
+
+bool LatencyMeter::Process(MIDITimedMessage* msg) {
+    long long now = GetTimeNs();
+    const MIDISystemExclusive* sysex = msg->GetSysEx();
+    if (!msg->IsSysEx() || !sysex)
+        return true;
+    const unsigned char* buf = sysex->GetBuffer();
+    unsigned int len = sysex->GetLength();
+    bool ok = (len == SHORT_LEN || len == LONG_LEN) && buf[0] == 0xf0 && buf[len - 1] == 0xf7;
+    for (unsigned int i = 2 + TIME_BYTES; ok && i < len - 1; i++)
+        ok = (buf[i] == ((i + buf[1]) & 0x7f));
+    num_received++;
+    if (!ok) {
+        num_bad++;
+        return true;
+    }
+    if (len == LONG_LEN)
+        num_long++;
+    long long sent = 0;
+    for (unsigned int i = 0; i < TIME_BYTES; i++)
+        sent = (sent << 7) | buf[2 + i];
+    long long latency = now - sent;
+    sum_latency += latency;
+    if (latency > max_latency)
+        max_latency = latency;
+    return true;
+}
+
+
+int Consumer(int ready_fd) {
+    LatencyMeter meter;
+    MIDIShmInDriver* in_driver = new MIDIShmInDriver(MIDIManager::GetNumMIDIIns(), SHM_NAME,
+                                                     MIDIShmOutDriver::DEFAULT_NUM_RECORDS, 4096);
+    MIDIManager::AddInDriver(in_driver);
+    in_driver->SetProcessor(&meter);
+    in_driver->OpenPort();
+    char c = in_driver->IsPortOpen() ? 1 : 0;
+    write(ready_fd, &c, 1);                 // tells the publisher we are ready
+    close(ready_fd);
+    if (!c)
+        return EXIT_FAILURE;
+
+    // waits for all the messages (or a second without new ones)
+    unsigned int last = 0;
+    for (unsigned int idle = 0; meter.num_received < NUM_MESSAGES && idle < 100; idle++) {
+        MIDITimer::Wait(10);
+        if (meter.num_received != last) {
+            last = meter.num_received;
+            idle = 0;
+        }
+    }
+    in_driver->ClosePort();
+
+    unsigned int good = meter.num_received - meter.num_bad;
+    cout << endl << "Consumer: received " << meter.num_received << " messages of " << NUM_MESSAGES
+         << " (" << meter.num_long << " long sysex, " << meter.num_bad << " corrupted)" << endl;
+    if (good > 0)
+        cout << "Latency: average " << meter.sum_latency / good / 1000.0 << " usecs, max "
+             << meter.max_latency / 1000.0 << " usecs" << endl;
+    return meter.num_received == NUM_MESSAGES && meter.num_bad == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+int main() {
+    int fds[2];
+    if (pipe(fds) == -1) {
+        cout << "Cannot create the pipe" << endl;
+        return EXIT_FAILURE;
+    }
+    pid_t pid = fork();
+    if (pid == -1) {
+        cout << "Cannot start the consumer process" << endl;
+        return EXIT_FAILURE;
+    }
+    if (pid == 0) {                         // the consumer process
+        close(fds[0]);
+        return Consumer(fds[1]);
+    }
+
+    // the publisher process
+    close(fds[1]);
+    char c = 0;
+    read(fds[0], &c, 1);                    // waits for the consumer
+    close(fds[0]);
+    MIDIShmOutDriver* out_driver = new MIDIShmOutDriver(MIDIManager::GetNumMIDIOuts(), SHM_NAME);
+    MIDIManager::AddOutDriver(out_driver);
+    out_driver->OpenPort();
+    if (!c || !out_driver->IsPortOpen()) {
+        cout << "Cannot open the shared memory ports" << endl;
+        waitpid(pid, 0, 0);
+        return EXIT_FAILURE;
+    }
+
+    unsigned char buf[LONG_LEN];
+    MIDITimedMessage msg;
+    for (unsigned int i = 0; i < NUM_MESSAGES; i++) {
+        unsigned int len = (i % 2 ? LONG_LEN : SHORT_LEN);
+        buf[0] = 0xf0;
+        buf[1] = i & 0x7f;
+        for (unsigned int j = 2 + TIME_BYTES; j < len - 1; j++)
+            buf[j] = (j + buf[1]) & 0x7f;
+        buf[len - 1] = 0xf7;
+        long long now = GetTimeNs();        // the send time, as late as possible
+        for (unsigned int j = TIME_BYTES; j > 0; j--, now >>= 7)
+            buf[1 + j] = now & 0x7f;
+        MIDISystemExclusive sysex(buf, len);
+        msg.SetSysEx(&sysex);
+        out_driver->OutputMessage(msg);
+        MIDITimer::Wait(1);
+    }
+    cout << "Publisher: sent " << NUM_MESSAGES << " messages" << endl;
+
+    int status = EXIT_FAILURE;
+    waitpid(pid, &status, 0);
+    out_driver->ClosePort();
+    shm_unlink(SHM_NAME);                   // removes the shared memory from the system
+    return WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE;
+}
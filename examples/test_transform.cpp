@@ -0,0 +1,127 @@
+/*
+ *   Example file for NiCMidi - A C++ Class Library for MIDI
+ *
+ *   Copyright (C) 2021, 2022  Nicola Cassetta
+ *   https://github.com/ncassetta/NiCMidi
+ *
+ *   This file is part of NiCMidi.
+ *
+ *   NiCMidi is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   NiCMidi is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with NiCMidi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+  A simple program which tests the quantizing of the MIDITransform class: it
+  fills a track with some notes (two of them overlapping with the same pitch),
+  quantizes it and checks that every Note On was moved on the grid, that every
+  note kept its length and that the track is still sorted.
+*/
+
+
+#include "../include/multitrack.h"
+#include "../include/transform.h"
+
+using namespace std;
+
+const MIDIClockTime GRID = 120;
+
+struct TestNote {
+    MIDIClockTime on_time;
+    MIDIClockTime off_time;
+    unsigned char note;
+};
+
+// the first two notes overlap and have the same pitch: the first Note Off is paired with the first
+// Note On, so the quantized notes must end at 45 and 50 (not at 35 and 60)
+const TestNote notes[] = {
+    {   5,  50, 60 },
+    {  10,  60, 60 },
+    { 130, 200, 62 },
+    { 250, 370, 64 },
+    { 355, 420, 60 },
+    { 490, 600, 67 }
+};
+const unsigned int NUM_NOTES = sizeof(notes) / sizeof(TestNote);
+
+
+void PrintTrack(const MIDITrack* trk) {
+    for (unsigned int i = 0; i < trk->GetNumEvents(); i++)
+        cout << trk->GetEvent(i).MsgToText() << endl;
+}
+
+
+int main() {
+    MIDIMultiTrack multi(1);
+    MIDITrack* trk = multi.GetTrack(0);
+    MIDITimedMessage msg;
+    for (unsigned int i = 0; i < NUM_NOTES; i++) {
+        msg.SetNoteOn(0, notes[i].note, 100);
+        msg.SetTime(notes[i].on_time);
+        trk->InsertEvent(msg, INSMODE_INSERT);
+        msg.SetNoteOff(0, notes[i].note, 0);
+        msg.SetTime(notes[i].off_time);
+        trk->InsertEvent(msg, INSMODE_INSERT);
+    }
+    cout << "Original track:" << endl;
+    PrintTrack(trk);
+
+    MIDITransform tr;
+    tr.SetQuantize(GRID);
+    multi.Transform(tr);
+    cout << "Quantized track:" << endl;
+    PrintTrack(trk);
+
+    unsigned int errors = 0;
+    for (unsigned int i = 1; i < trk->GetNumEvents(); i++)
+        if (trk->GetEvent(i).GetTime() < trk->GetEvent(i - 1).GetTime()) {
+            cout << "Event " << i << " is not sorted" << endl;
+            errors++;
+        }
+    // the expected Note Off times, which must be found (once) in the track
+    vector<bool> found(NUM_NOTES, false);
+    unsigned int num_ons = 0, num_offs = 0;
+    for (unsigned int i = 0; i < trk->GetNumEvents(); i++) {
+        const MIDITimedMessage& ev = trk->GetEvent(i);
+        if (ev.IsNoteOn()) {
+            num_ons++;
+            if (ev.GetTime() % GRID != 0) {
+                cout << "Note On at " << ev.GetTime() << " is not on the grid" << endl;
+                errors++;
+            }
+        }
+        else if (ev.IsNoteOff()) {
+            num_offs++;
+            unsigned int j = 0;
+            for ( ; j < NUM_NOTES; j++) {
+                MIDIClockTime on_time = (notes[j].on_time + GRID / 2) / GRID * GRID;
+                if (!found[j] && notes[j].note == ev.GetNote() &&
+                    on_time + notes[j].off_time - notes[j].on_time == ev.GetTime())
+                    break;
+            }
+            if (j == NUM_NOTES) {
+                cout << "Note Off at " << ev.GetTime() << " doesn't keep the length of its note" << endl;
+                errors++;
+            }
+            else
+                found[j] = true;
+        }
+    }
+    if (num_ons != NUM_NOTES || num_offs != NUM_NOTES) {
+        cout << "Found " << num_ons << " Note On and " << num_offs << " Note Off (expected " << NUM_NOTES
+             << ")" << endl;
+        errors++;
+    }
+
+    cout << (errors ? "Test FAILED" : "Test OK") << endl;
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
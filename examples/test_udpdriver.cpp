@@ -0,0 +1,91 @@
+/*
+ *   Example file for NiCMidi - A C++ Class Library for MIDI
+ *
+ *   Copyright (C) 2021, 2022  Nicola Cassetta
+ *   https://github.com/ncassetta/NiCMidi
+ *
+ *   This file is part of NiCMidi.
+ *
+ *   NiCMidi is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   NiCMidi is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with NiCMidi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+  A simple program which tests the MIDIUdpOutDriver and MIDIUdpInDriver classes
+  over the loopback address: it sends bursts of notes from the out driver to
+  the in driver (in the same process, so they share the MIDITimer time) and
+  prints the throughput, the latency and the lost datagrams.
+*/
+
+
+#include "../include/manager.h"
+#include "../include/udpdriver.h"
+
+using namespace std;
+
+const unsigned int NUM_BURSTS = 200;
+const unsigned int BURST_SIZE = 50;
+const unsigned short TEST_PORT = 5004;
+
+
+int main() {
+    MIDIUdpOutDriver* out_driver = new MIDIUdpOutDriver(MIDIManager::GetNumMIDIOuts(), "127.0.0.1", TEST_PORT);
+    MIDIUdpInDriver* in_driver = new MIDIUdpInDriver(MIDIManager::GetNumMIDIIns(), TEST_PORT, 4096);
+    MIDIManager::AddOutDriver(out_driver);
+    MIDIManager::AddInDriver(in_driver);
+    in_driver->OpenPort();
+    out_driver->OpenPort();
+    if (!in_driver->IsPortOpen() || !out_driver->IsPortOpen()) {
+        cout << "Cannot open the UDP ports" << endl;
+        return EXIT_FAILURE;
+    }
+
+    // we pack the messages ourselves, as the timer is not running
+    out_driver->SetAutoFlush(false);
+
+    MIDITimedMessage msg;
+    unsigned long received = 0;
+    MIDIRawMessage raw_msg;
+    tMsecs start = MIDITimer::GetSysTimeMs();
+    for (unsigned int i = 0; i < NUM_BURSTS; i++) {
+        // the out driver packs the messages and sends them when we call FlushOutput()
+        // (the MIDIManager does this at every timer tick)
+        for (unsigned int j = 0; j < BURST_SIZE; j++) {
+            msg.SetNoteOn(j % 16, 36 + j, 100);
+            out_driver->OutputMessage(msg);
+        }
+        out_driver->FlushOutput();
+        MIDITimer::Wait(1);
+        while (in_driver->InputMessage(raw_msg))
+            received++;
+    }
+    // wait for the last datagrams
+    MIDITimer::Wait(100);
+    while (in_driver->InputMessage(raw_msg))
+        received++;
+    tMsecs elapsed = MIDITimer::GetSysTimeMs() - start;
+
+    cout << endl << "Sent " << out_driver->GetNumMessages() << " messages in "
+         << out_driver->GetNumPackets() << " datagrams" << endl;
+    cout << "Received " << received << " messages in " << in_driver->GetNumPackets() << " datagrams ("
+         << in_driver->GetNumLost() << " lost, " << in_driver->GetNumRecovered() << " recovered from the journal)"
+         << endl;
+    cout << "Elapsed time " << elapsed << " msecs (" << received * 1000.0 / (elapsed ? elapsed : 1)
+         << " messages per second)" << endl;
+    cout << "Latency: average " << in_driver->GetAverageLatency() << " msecs, max "
+         << in_driver->GetMaxLatency() << " msecs" << endl;
+
+    out_driver->ClosePort();
+    in_driver->ClosePort();
+    return received == out_driver->GetNumMessages() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -185,10 +185,11 @@ class AdvancedSequencer : public MIDISequencer {
         /// Returns the mode (major/minor) of the he current key signature.
         /// See MIDIMessage::GetKeySigMode().
         int                 GetKeySigMode() const;
-        /// Returns the current marker text.
-        std::string         GetCurrentMarker() const;
-        /// Returns the name of the given track.
-        std::string         GetTrackName(unsigned int trk_num) const;
+        /// Returns the current marker text. The reference remains valid until the multitrack is destroyed,
+        /// so the GUI can query it at every refresh without copying.
+        const std::string&  GetCurrentMarker() const;
+        /// Returns the name of the given track (see GetCurrentMarker()).
+        const std::string&  GetTrackName(unsigned int trk_num) const;
         /// Returns the current MIDI volume for the given track (-1 if volume wasn't set at time 0).
         int                 GetTrackVolume(unsigned int trk_num) const;     // MIDI value or -1
         /// Returns the current MIDI program (patch) for the given track (-1 if the program wasn't set  at time 0).
@@ -0,0 +1,161 @@
+/*
+ *   NiCMidi - A C++ Class Library for MIDI
+ *
+ *   Copyright (C) 2021, 2022  Nicola Cassetta
+ *   https://github.com/ncassetta/NiCMidi
+ *
+ *   This file is part of NiCMidi.
+ *
+ *   NiCMidi is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   NiCMidi is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with NiCMidi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/// \file
+/// Contains the definition of the classes MIDICompressedTrack and MIDICompressedTrackIterator, used to keep
+/// in memory many tracks in a compact form.
+
+
+#ifndef _JDKMIDI_COMPRESSEDTRACK_H
+#define _JDKMIDI_COMPRESSEDTRACK_H
+
+#include "track.h"
+
+#include <vector>
+#include <cstdint>
+
+
+///
+/// An immutable copy of the events of a MIDITrack, encoded in a compact form similar to the one of MIDI
+/// files: every event is stored as its delta time (a variable length number) followed by its bytes, and the
+/// status byte of channel messages is omitted when it is the same of the previous one (running status). A
+/// typical channel event takes 2 ... 4 bytes instead of the 16 bytes of a MIDITimedMessage (plus the memory
+/// of sysex and meta data), so you can keep many songs in memory and expand only the one you want to play with
+/// Decompress().
+///
+/// Every SEEK_INTERVAL events the object stores a seek point (the position and the decoding status at that
+/// event), so a MIDICompressedTrackIterator can go to any time decoding only a few events.
+///
+class MIDICompressedTrack {
+    public:
+        /// Creates an empty object (with no events, not even the EOT).
+                                MIDICompressedTrack() : num_events(0) {}
+        /// Creates an object containing the events of _trk_.
+                                MIDICompressedTrack(const MIDITrack* trk) : num_events(0) { Compress(trk); }
+
+        /// Replaces the content of the object with the events of _trk_.
+        void                    Compress(const MIDITrack* trk);
+        /// Replaces the content of _trk_ with the events stored in the object (the other track parameters,
+        /// as ports and time shift, are not changed).
+        void                    Decompress(MIDITrack* trk) const;
+        /// Deletes all the events, freeing the memory.
+        void                    Clear();
+
+        /// Returns the number of events (the EOT included, as MIDITrack::GetNumEvents()).
+        unsigned int            GetNumEvents() const            { return num_events; }
+        /// Returns the time of the EOT event.
+        MIDIClockTime           GetEndTime() const              { return end_time; }
+        /// Returns the number of bytes used by the object.
+        unsigned long           GetMemorySize() const
+                                    { return sizeof(*this) + data.capacity() +
+                                             seek_points.capacity() * sizeof(SeekPoint); }
+
+        /// The number of events between two seek points.
+        static const unsigned int SEEK_INTERVAL = 64;
+
+    protected:
+        /// \cond EXCLUDED
+        friend class MIDICompressedTrackIterator;
+
+        // The status of the decoder before the event ev_num, which is at position offset of data.
+        struct SeekPoint {
+            MIDIClockTime       prev_time;      // The time of the previous event
+            uint32_t            offset;
+            uint32_t            ev_num;
+            unsigned char       running_status;
+        };
+
+        // Appends the event msg to data.
+        void                    Encode(const MIDITimedMessage& msg, MIDIClockTime prev_time,
+                                       unsigned char& running_status);
+        // Decodes into msg the event at position offset, updating offset, prev_time and running_status.
+        void                    Decode(MIDITimedMessage& msg, uint32_t& offset, MIDIClockTime& prev_time,
+                                       unsigned char& running_status) const;
+        // Appends the variable length number n to data.
+        void                    PutVarLen(unsigned long n);
+        // Reads a variable length number from data at position offset, updating offset.
+        unsigned long           GetVarLen(uint32_t& offset) const;
+
+        std::vector<unsigned char>  data;           // The encoded events
+        std::vector<SeekPoint>  seek_points;        // The seek points (one every SEEK_INTERVAL events)
+        unsigned int            num_events;         // The number of events
+        MIDIClockTime           end_time;           // The time of the EOT
+
+        // In the encoded data a status byte less than 0x80 (the service messages) or equal to ESCAPE is
+        // preceded by ESCAPE, so it cannot be mistaken for a data byte in running status.
+        enum { ESCAPE = 0xfd };
+        /// \endcond
+};
+
+
+///
+/// Forward iterator for moving along a MIDICompressedTrack, decoding its events on the fly. It has the same
+/// interface of MIDITrackIterator (without the track status methods), but GetNextEvent() copies the event
+/// into a message given by the caller, as the events don't exist in memory as MIDITimedMessage objects.
+/// GoToTime() uses the seek points of the track, so it doesn't decode all the events before the given time.
+///
+class MIDICompressedTrackIterator {
+    public:
+        /// The constructor. You must specify the track which the iterator is attached to.
+                                MIDICompressedTrackIterator(const MIDICompressedTrack* trk);
+        /// Sets the current time to 0 and the current event to the first of the track.
+        void                    Reset();
+        /// Returns a pointer to the track the iterator is attached to.
+        const MIDICompressedTrack* GetTrack() const             { return track; }
+        /// Sets the iterator track (causes a reset).
+        void                    SetTrack(const MIDICompressedTrack* trk);
+        /// Returns the current time of the iterator.
+        MIDIClockTime           GetCurrentTime() const          { return cur_time; }
+        /// Returns the current event number in the track.
+        unsigned int            GetCurrentEventNum() const      { return cur_ev_num; }
+        /// Goes to the given time, which becomes the current time, and sets then the current event as the
+        /// first event in the track with time greater or equal to _time_.
+        /// \return **false** if _time_ is greater than the track end time (and nothing is done).
+        bool                    GoToTime(MIDIClockTime time);
+        /// Copies the next event in the track into _msg_, and advances the current event.
+        /// \return **true** if there is effectively a next event (we aren't at the end of the
+        /// track), **false** otherwise (and _msg_ is unchanged).
+        bool                    GetNextEvent(MIDITimedMessage* msg);
+        /// Gets the time of the next event in the track (it can be different from current time if
+        /// at current time there are not events).
+        /// \param t here we get the time of next event, if valid.
+        /// \return **true** if there is effectively a next event (we aren't at the end of the
+        /// track), **false** otherwise (and _t_ doesn't contain a valid value).
+        bool                    GetNextEventTime(MIDIClockTime* t) const;
+
+    protected:
+        /// \cond EXCLUDED
+        // Sets the decoder status to the seek point sp.
+        void                    SetSeekPoint(unsigned int sp);
+
+        const MIDICompressedTrack* track;
+        MIDIClockTime           cur_time;           // The current time
+        unsigned int            cur_ev_num;         // The number of the next event
+        uint32_t                offset;             // The position of the next event in the track data
+        MIDIClockTime           prev_time;          // The time of the last decoded event
+        unsigned char           running_status;     // The running status of the decoder
+        /// \endcond
+};
+
+
+#endif // _JDKMIDI_COMPRESSEDTRACK_H
@@ -32,13 +32,16 @@
 #define _JDKMIDI_DRIVER_H
 
 #include "msg.h"
+#include "ump.h"
 #include "processor.h"
+#include "matrix.h"
 #include "timer.h"
 
 
 #include "../rtmidi-4.0.0/RtMidi.h"
 
 #include <vector>
+#include <deque>
 #include <string>
 #include <mutex>
 //#include <atomic>
@@ -52,13 +55,11 @@
 
 /// This item only affects AllNotesOff() function. All modern MIDI devices should respond to all notes off
 /// messages so usually there is no need to stop notes sending Note off messages.
-/// If you set this to 1 the driver will keep track of all sounding notes and, if the AllNotesOff() method is
-/// called, will send a Note Off message for each one, plus a damper off message for every channel. This is
-/// quite expensive, so turn this on only if you experience notes sounding when you stop a sequencer.
+/// This is the default value of the MIDIOutDriver note tracking option (see MIDIOutDriver::SetNoteTracking()):
+/// if you set this to 1 every driver will keep track of all sounding notes and, if the AllNotesOff() method is
+/// called, will send a Note Off message for each one, plus a damper off message for every channel with the
+/// pedal down. You can also turn tracking on and off at runtime for every port.
 #define DRIVER_USES_MIDIMATRIX 0
-#if DRIVER_USES_MIDIMATRIX
-   #include "matrix.h"
-#endif // DRIVER_USES_MIDIMATRIX
 ///@}
 
 
@@ -77,43 +78,70 @@ struct MIDIRawMessage {
 
 
 // EXCLUDED FROM DOCUMENTATION BECAUSE UNDOCUMENTED
-// This is a queue of MIDIRawMessage
+// This is a queue of MIDIRawMessage. The messages are not stored as MIDIMessage objects, but converted
+// into MIDIUmp packets (a sysex takes more than one), so putting short messages into the queue only moves
+// plain words; they are converted back when they are got from the queue (this allocates the sysex objects).
+// Sysex longer than a quarter of the queue (as patch and bulk dumps) are not converted: they are kept as
+// MIDIMessage in a separate list, and a utility packet marks their place in the queue.
 class MIDIRawMessageQueue {
     public:
-        // The constructor creates a queue of the given size. When the queue is full, older messages
-        // are pulled from the queue.
-
+        // The constructor creates a queue of the given size (in packets). When the queue is full, older
+        // messages are pulled from the queue.
                                         MIDIRawMessageQueue(unsigned int size) :
-                                                                    next_in(0), next_out(0), buffer(size) {}
-        // The destructor deletes all the MIDIRawMessage objects actually contained in the queue.
+                                                                    next_in(0), next_out(0), num_messages(0),
+                                                                    read_index(0), read_pos(0), read_large(0),
+                                                                    buffer(size) {}
+        // The destructor does nothing.
         virtual                         ~MIDIRawMessageQueue()      {}
-        // Empties the queue and turns into a NoOp all the messages contained.
-        void                            Reset();
+        // Empties the queue.
+        void                            Reset()                     { Flush(); }
         // Quickly empties the queue acting only on in and out indexes.
-        void                            Flush()                     { next_out = next_in; }
+        void                            Flush();
         // Adds the given MIDIRawMessage as the last element in the queue. If the queue was full
-        // the first message is pulled out.
+        // the first messages are pulled out. Messages which cannot be converted to packets (as
+        // NoOp or meta events) are ignored.
         void                            PutMessage(const MIDIRawMessage& msg);
         // Gets the first MIDIRawMessage in the queue, pulling it out. It returns a reference
-        // to a static copy, which is valid until the next call to the function.
+        // to an internal copy, which is valid until the next call to the function.
         MIDIRawMessage&                 GetMessage();
-        // Gets the n-th MIDIRawMessage in the queue, without pulling it out. It returns a
-        // direct reference to the message (and it's so faster than GetMessage(), which copies it)
-        // which is valid until an operation on the queue is done. If the queue has an actual
-        // size lesser than _n_, returns a NoOp message.
+        // Gets the n-th MIDIRawMessage in the queue, without pulling it out. It returns a reference
+        // to an internal copy, valid until an operation on the queue is done. Reading the messages in
+        // order (n = 0, 1, 2 ...) is fast. If the queue has an actual size lesser than _n_, returns a
+        // NoOp message.
         MIDIRawMessage&                 ReadMessage(unsigned int n);
         // Returns *true* is the queue is empty.
-        bool                            IsEmpty() const             { return next_in == next_out; }
+        bool                            IsEmpty() const             { return num_messages == 0; }
         // Returns *true* if the queue has reached its max size (you can however add other messages,
         // deleting the older ones.
         bool                            IsFull() const              { return ((next_in + 1) % buffer.size()) == next_out; }
-        // Returns the actual length of the queue.
-        unsigned int                    GetLength() const           { return (next_in - next_out) % buffer.size(); }
+        // Returns the actual length of the queue (in messages).
+        unsigned int                    GetLength() const           { return num_messages; }
 
     protected:
+        // A queue element: a packet, with the time and the port of the message it belongs to.
+        struct Record {
+            MIDIUmp                     ump;
+            tMsecs                      timestamp;
+            int                         port;
+        };
+
+        // Returns **true** if at pos there is the marker of a message in large_msgs.
+        bool                            IsLarge(unsigned int pos) const
+                                            { return buffer[pos].ump.GetMessageType() == MIDIUmp::UMP_UTILITY; }
+        // Returns the position of the message following the one starting at pos.
+        unsigned int                    NextMessage(unsigned int pos) const;
+        // Converts the packets starting at pos into msg, returning the position of the next message.
+        unsigned int                    DecodeMessage(unsigned int pos, MIDIRawMessage& msg) const;
+
         unsigned int                    next_in;
         unsigned int                    next_out;
-        std::vector<MIDIRawMessage>     buffer;
+        unsigned int                    num_messages;
+        unsigned int                    read_index;     // the index and the position of the message
+        unsigned int                    read_pos;       // following the last one read by ReadMessage()
+        unsigned int                    read_large;     // the markers between next_out and read_pos
+        std::vector<Record>             buffer;
+        std::deque<MIDIMessage>         large_msgs;     // the long sysex, in the same order of their markers
+        MIDIRawMessage                  out_msg;        // the message returned by GetMessage() and ReadMessage()
 };
 
 
@@ -146,9 +174,14 @@ class MIDIOutDriver {
         /// Returns the id number of the hardware out port
         int                     GetPortId() const               { return port_id; }
         /// Returns the name of the hardware out port.
-        std::string             GetPortName()                   { return port->getPortName(port_id); }
+        virtual std::string     GetPortName()                   { return port->getPortName(port_id); }
         /// Returns **true** is the hardware port is open.
-        bool                    IsPortOpen() const              { return port->isPortOpen(); }
+        virtual bool            IsPortOpen() const              { return port->isPortOpen(); }
+        /// Returns **true** if the driver keeps track of the sounding notes (see SetNoteTracking()).
+        bool                    GetNoteTracking() const         { return note_tracking; }
+        /// Returns **true** if the driver doesn't send messages which wouldn't change the device state
+        /// (see SetSkipRedundant()).
+        bool                    GetSkipRedundant() const        { return skip_redundant; }
         /// Returns a pointer to the out processor.
         MIDIProcessor*          GetOutProcessor()               { return processor; }
         /// Returns a pointer to the out processor.
@@ -159,6 +192,21 @@ class MIDIOutDriver {
         /// pointer to 0! The driver doesn't own its processor).
         virtual void            SetOutProcessor(MIDIProcessor* proc)
                                                                 { processor = proc; }
+        /// Turns on and off the tracking of the notes sent to the port. If it is on, AllNotesOff() sends
+        /// a Note Off only for the notes actually sounding (and a damper off if the pedal is down) instead
+        /// of the All Notes Off controller, which some devices ignore. The default is given by
+        /// \ref DRIVER_USES_MIDIMATRIX.
+        void                    SetNoteTracking(bool on);
+        /// The driver always remembers the last program, pitch bend, channel pressure and controller values sent
+        /// on every channel. If you turn this on, OutputMessage() doesn't send a message which would set a value
+        /// the device already has: this cuts the bursts of messages sent by the sequencer when you move the time,
+        /// mute or unmute a track or loop, which can be slow on slow links. Data entry, RPN and NRPN controllers
+        /// are always sent, as their effect depends on the previous messages. Default is off.
+        void                    SetSkipRedundant(bool on);
+        /// Forgets the values remembered for SetSkipRedundant(), so that the next messages will be sent
+        /// anyway. Call this if the device state could have been changed by someone else (for example if
+        /// the device was switched off).
+        void                    ResetShadow();
 
         /// Opens the hardware out port. This usually requires a noticeable amount of time, so it's better
         /// not to immediately start to send messages. If the port is already open the object remembers how many
@@ -169,24 +217,47 @@ class MIDIOutDriver {
         /// the closure call Reset().
         virtual void            ClosePort();
         /// Turns off all the sounding notes on the port (or on the given MIDI channel). This is normally
-        /// done by sending an All Notes Off message, but you can change this behaviour (see \ref DRIVER_USES_MIDIMATRIX).
+        /// done by sending an All Notes Off message, but you can change this behaviour (see SetNoteTracking()).
         /// See also \ref NUMBERING.
         /// \param chan if you left the default silences all channels, otherwise you can give an unique channel
         /// to turn off
         virtual void            AllNotesOff(int chan = -1);
         /// Makes a copy of the message, processes it with the out processor and then sends it to
-        /// the hardware port. If the port is busy waits 1 msec and retries until \ref DRIVER_MAX_RETRIES
+        /// the hardware port (if the processor returns **false** the message is not sent, so you can use it
+        /// for filtering, for example with a MIDIProcessorCompactor). If the port is busy waits 1 msec and retries until \ref DRIVER_MAX_RETRIES
         /// is reached.
             // TODO: actually it writes to cerr, Should we raise an exception?
         virtual void            OutputMessage(const MIDITimedMessage& msg);
+        /// Same as OutputMessage(), but the caller gives also the system time (in msecs, see
+        /// MIDITimer::GetSysTimeMs()) at which the message is due. The MIDIOutDriver ignores it and sends
+        /// the message immediately, while drivers which can schedule messages (as MIDIJackOutDriver)
+        /// use it to place the message at the exact time. The MIDISequencer sends its messages with this.
+        virtual void            OutputTimedMessage(const MIDITimedMessage& msg, double sys_time)
+                                                                { OutputMessage(msg); }
+        /// Sends the messages buffered by the driver, if any. The MIDIOutDriver sends every message
+        /// immediately so this does nothing, while drivers which pack many messages together (as
+        /// MIDIUdpOutDriver) send them here. It is called by the MIDIManager at the end of every timer tick.
+        virtual void            FlushOutput()                   {}
 
     protected:
+        /// Used by derived classes which don't communicate through RtMidi (as MIDIShmOutDriver): it creates
+        /// the embedded RtMidiOut with the given API (typically RtMidi::RTMIDI_DUMMY).
+                                MIDIOutDriver (int id, RtMidi::Api api);
+
         /// The maximum number of retries the method OutputMessage() will try before hanging (and skipping a message).
         static const int        DRIVER_MAX_RETRIES = 100;
         /// The number of milliseconds the driver waits after sending a MIDI system exclusive message.
         static const int        DRIVER_WAIT_AFTER_SYSEX = 20;
         /// Sends the message to the hardware MIDI port using the RtMidi library functions.
         virtual void            HardwareMsgOut(const MIDIMessage &msg);
+        /// Updates the note tracking matrix with the given message (derived classes must call this
+        /// in their HardwareMsgOut()).
+        void                    TrackNotes(const MIDIMessage &msg)
+                                                                { if (note_tracking) out_notes.Update(msg); }
+        /// Updates the values remembered for SetSkipRedundant() with the given message. Returns **false** if
+        /// SetSkipRedundant() is on and the message wouldn't change the device state (so it must not be sent),
+        /// **true** otherwise.
+        bool                    UpdateShadow(const MIDIMessage &msg);
 
        /// \cond EXCLUDED
         MIDIProcessor*          processor;  // The out processor
@@ -194,10 +265,14 @@ class MIDIOutDriver {
         const int               port_id;    // The id of the port
         int                     num_open;   // Counts the number of OpenPort() calls
         std::recursive_mutex    out_mutex;  // Used internally for thread safe operating
-
-#if DRIVER_USES_MIDIMATRIX
-        MIDIMatrix              out_matrix; // To keep track of notes on going to MIDI out
-#endif // DRIVER_USES_MIDIMATRIX
+        bool                    note_tracking;  // If true the out_notes matrix is updated
+        MIDINoteBitMatrix       out_notes;  // To keep track of notes on going to MIDI out
+        bool                    skip_redundant; // If true UpdateShadow() returns false for redundant messages
+        signed char             shadow_program[16];         // The last values sent on every channel
+        signed char             shadow_pressure[16];        // (-1 if unknown)
+        int16_t                 shadow_bender[16];          // (SHADOW_UNKNOWN_BENDER if unknown)
+        signed char             shadow_controls[16][C_ALL_SOUND_OFF];
+        static const int16_t    SHADOW_UNKNOWN_BENDER = -32768;
         /// \endcond
 
     private:
@@ -223,8 +298,10 @@ class MIDIInDriver {
         /// Creates a MIDIInDriver object which can receive MIDI messages from the given hardware in port.
         /// \param id The id of the hardware port. Numbers of the ports and their names can be retrieved
         /// by the MIDIManager::GetNumMIDIOutPorts() and MIDIManager::GetMIDIOutName() static methods.
-        /// \param queue_size The size of the queue; you could try to change this if you have trouble in
-        /// receiving MIDI messages from the hardware, otherwise left unchanged (default size is 256).
+        /// \param queue_size The size of the queue in packets (a short message takes a packet, a sysex
+        /// a packet every 6 bytes, while sysex longer than a quarter of the queue are stored apart); you
+        /// could try to change this if you have trouble in receiving MIDI messages from the hardware,
+        /// otherwise left unchanged (default size is 256).
         /// \note If id is not valid or the function fails, a dummy port with no functionality is created.
         /// \note As said in the class description, the drivers are created automatically by the
         /// MIDIManager when the program starts, so usually you must not create or destroy them by yourself.
@@ -241,9 +318,9 @@ class MIDIInDriver {
         /// Returns the id number of the hardware in port.
         int                     GetPortId() const               { return port_id; }
         /// Returns the name of the hardware in port.
-        std::string             GetPortName()                   { return port->getPortName(port_id); }
+        virtual std::string     GetPortName()                   { return port->getPortName(port_id); }
         /// Returns **true** is the hardware port is open.
-        bool                    IsPortOpen() const              { return port->isPortOpen(); }
+        virtual bool            IsPortOpen() const              { return port->isPortOpen(); }
         /// Returns **true** if the queue is non-empty.
         bool                    CanGet() const                  { return in_queue.GetLength() > 0; }
         /// Returns the queue size.
@@ -289,11 +366,18 @@ class MIDIInDriver {
         virtual bool            ReadMessage(MIDIRawMessage& msg, unsigned int n);
 
 protected:
+        /// Used by derived classes which don't communicate through RtMidi (as MIDIShmInDriver): it creates
+        /// the embedded RtMidiIn with the given API (typically RtMidi::RTMIDI_DUMMY).
+                                MIDIInDriver(int id, RtMidi::Api api, unsigned int queue_size);
 
         /// This is the RtMidi callback function (you must not call it directly)
         static void             HardwareMsgIn(double time,
                                               std::vector<unsigned char>* msg_bytes,
                                               void* p);
+        /// Builds the message _msg_ from the _len_ raw MIDI bytes in _bytes_ (used by HardwareMsgIn() and by
+        /// derived classes). Returns **false** if the bytes don't make a valid message.
+        static bool             DecodeMessage(const unsigned char* bytes, unsigned int len,
+                                              MIDITimedMessage& msg);
 
         /// \cond EXCLUDED
         // This is the default queue size.
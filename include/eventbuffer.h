@@ -0,0 +1,111 @@
+/*
+ *   NiCMidi - A C++ Class Library for MIDI
+ *
+ *   Copyright (C) 2021, 2022  Nicola Cassetta
+ *   https://github.com/ncassetta/NiCMidi
+ *
+ *   This file is part of NiCMidi.
+ *
+ *   NiCMidi is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   NiCMidi is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with NiCMidi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/// \file
+/// Contains the definition of the class MIDIEventBuffer, the container of the events of a MIDITrack.
+
+
+#ifndef _JDKMIDI_EVENTBUFFER_H
+#define _JDKMIDI_EVENTBUFFER_H
+
+#include "msg.h"
+
+#include <vector>
+#include <utility>
+
+
+///
+/// A gap buffer of MIDITimedMessage objects, used by the MIDITrack for storing its events. The events are kept
+/// in a single array with a hole (the gap) at the position of the last insertion or deletion, so a new
+/// insertion or deletion only moves the events between the old and the new position, instead of all the events
+/// up to the end of the track as a std::vector does. This makes repeated editing around the same point of a
+/// long track (as in step recording) very fast, while the access by index remains immediate and the events
+/// are still contiguous in memory (in two blocks, before and after the gap).
+///
+/// The method names are the same of std::vector, but positions are given as indexes instead of iterators.
+/// As with std::vector, pointers to the events are invalidated by insertions and deletions.
+///
+class MIDIEventBuffer {
+    public:
+        /// Creates an empty buffer.
+                                MIDIEventBuffer() : gap_start(0), gap_end(0) {}
+        /// The copy constructor (the copy has the gap at the end).
+                                MIDIEventBuffer(const MIDIEventBuffer& buf);
+        /// The assignment operator.
+        MIDIEventBuffer&        operator=(const MIDIEventBuffer& buf);
+
+        /// Returns the number of events.
+        unsigned int            size() const                { return buffer.size() - (gap_end - gap_start); }
+        /// Returns **true** if there are no events.
+        bool                    empty() const               { return size() == 0; }
+        /// Returns the event _i_ (no range check is done).
+        MIDITimedMessage&       operator[](unsigned int i)  { return buffer[i < gap_start ? i : i + gap_end - gap_start]; }
+        /// Returns the event _i_ (no range check is done).
+        const MIDITimedMessage& operator[](unsigned int i) const
+                                    { return buffer[i < gap_start ? i : i + gap_end - gap_start]; }
+        /// Returns the last event (the buffer must not be empty).
+        MIDITimedMessage&       back()                      { return operator[](size() - 1); }
+        /// Returns the last event (the buffer must not be empty).
+        const MIDITimedMessage& back() const                { return operator[](size() - 1); }
+        /// Moves the gap at the end and returns a pointer to the first event: so the events are contiguous,
+        /// and you can use the pointers as random access iterators (for example for sorting them) until the
+        /// next insertion or deletion.
+        MIDITimedMessage*       data();
+
+        /// Allocates memory for _n_ events.
+        void                    reserve(unsigned int n);
+        /// Deletes all the events.
+        void                    clear();
+        /// Inserts the event _msg_ at the position _pos_ (0 ... size()).
+        void                    insert(unsigned int pos, const MIDITimedMessage& msg)
+                                    { insert(pos, MIDITimedMessage(msg)); }
+        /// The same as above, but _msg_ is moved into the buffer.
+        void                    insert(unsigned int pos, MIDITimedMessage&& msg);
+        /// Appends the event _msg_ to the end.
+        void                    push_back(const MIDITimedMessage& msg)
+                                    { insert(size(), MIDITimedMessage(msg)); }
+        /// The same as above, but _msg_ is moved into the buffer.
+        void                    push_back(MIDITimedMessage&& msg)
+                                    { insert(size(), std::move(msg)); }
+        /// Inserts at the position _pos_ a copy of _n_ events of the buffer _src_, starting from its event
+        /// _first_. The events after _pos_ are moved only once, however many events are inserted.
+        /// \warning _src_ must be another buffer.
+        void                    insert(unsigned int pos, const MIDIEventBuffer& src, unsigned int first,
+                                       unsigned int n);
+        /// Deletes _n_ events starting from the position _pos_.
+        void                    erase(unsigned int pos, unsigned int n = 1);
+
+    protected:
+        /// \cond EXCLUDED
+        // Moves the gap to the position pos.
+        void                    MoveGap(unsigned int pos);
+
+        std::vector<MIDITimedMessage>
+                                buffer;     // The events and the gap (filled with empty messages)
+        unsigned int            gap_start;  // The index in the buffer of the first gap element
+        unsigned int            gap_end;    // The index in the buffer of the first element after the gap
+        /// \endcond
+};
+
+
+#endif // _JDKMIDI_EVENTBUFFER_H
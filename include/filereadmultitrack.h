@@ -52,7 +52,7 @@ class MIDIFileReadMultiTrack : public MIDIFileEventHandler {
 /// \cond EXCLUDED
     public:
                                         MIDIFileReadMultiTrack (MIDIMultiTrack *tracks);
-        virtual                         ~MIDIFileReadMultiTrack()       {}
+        virtual                         ~MIDIFileReadMultiTrack();
 
 //
 // The possible events in a MIDI Files
@@ -97,10 +97,15 @@ class MIDIFileReadMultiTrack : public MIDIFileEventHandler {
         virtual	void                    ChanMessage(const MIDITimedMessage &msg);
 
     protected:
+            // adds an event to a track (without sorting it)
+        void                            PushEvent(int trk, MIDITimedMessage&& msg);
+            // sorts the events pushed into the tracks
+        void                            EndLoading();
 
         MIDIMultiTrack*                 multitrack;
         int                             cur_track;
         MIDIFileHeader                  header;
+        bool                            loading;
 /// \endcond
 };
 
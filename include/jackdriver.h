@@ -0,0 +1,162 @@
+/*
+ *   NiCMidi - A C++ Class Library for MIDI
+ *
+ *   Copyright (C) 2021, 2022  Nicola Cassetta
+ *   https://github.com/ncassetta/NiCMidi
+ *
+ *   This file is part of NiCMidi.
+ *
+ *   NiCMidi is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   NiCMidi is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with NiCMidi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/// \file
+/// Contains the definition of the class MIDIJackOutDriver, a MIDI out driver which can drive the
+/// library timing from the JACK process callback.
+
+
+#ifndef _JDKMIDI_JACKDRIVER_H
+#define _JDKMIDI_JACKDRIVER_H
+
+#include "driver.h"
+
+#ifdef __UNIX_JACK__
+
+#include <jack/jack.h>
+#include <jack/midiport.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+
+///
+/// Sends MIDI messages to a JACK MIDI out port, writing them directly into the JACK period buffer.
+/// The driver opens its own JACK client (so you must connect its port with the JACK tools or
+/// programmatically) and can work in two ways:
+/// - in normal mode messages are buffered and written at the start of the next JACK period.
+/// - in sync mode (see SetSyncMode()) the MIDITimer is switched to external clock and the JACK process
+///   callback ticks it once per period, so the sequencer (and every other MIDITickComponent) runs in the
+///   JACK thread; the messages sent by the sequencer are written at the frame offset corresponding to their
+///   exact time, so the timing no longer depends on the timer resolution.
+///
+/// This driver is not created by the MIDIManager: you must create it with new and add it to the
+/// manager with MIDIManager::AddOutDriver(), which assigns it a port number. You can test it with
+/// the dummy backend of jackd (jackd -d dummy).
+/// \note Only one MIDIJackOutDriver should be in sync mode. The driver is only available when the
+/// library is built with JACK support (i.e.\ when \_\_UNIX_JACK\_\_ is defined).
+class MIDIJackOutDriver : public MIDIOutDriver {
+    public:
+        /// Creates a MIDIJackOutDriver object.
+        /// \param id The port id (pass MIDIManager::GetNumMIDIOuts(), i.e. the number the port will have
+        /// when added to the manager).
+        /// \param client_name The name of the JACK client opened by the driver.
+        /// \param sync If **true** the driver is created in sync mode (see SetSyncMode()).
+                                MIDIJackOutDriver(int id, const std::string& client_name = "NiCMidi",
+                                                  bool sync = true);
+        /// Closes the JACK client and deletes the object.
+        virtual                 ~MIDIJackOutDriver();
+
+        /// Resets the driver to default conditions (see MIDIOutDriver::Reset()). The sync mode is
+        /// left unchanged.
+        virtual void            Reset();
+        /// Returns the full JACK name of the port (as "NiCMidi:midi_out").
+        virtual std::string     GetPortName();
+        /// Returns **true** is the JACK client is active.
+        virtual bool            IsPortOpen() const              { return client != 0; }
+        /// Returns **true** if the driver is in sync mode.
+        bool                    GetSyncMode() const             { return sync_mode; }
+        /// Returns the number of messages lost since the port was opened because the JACK buffer of the
+        /// period was full (the JACK thread never waits or prints errors, so it only counts them).
+        unsigned int            GetNumLost() const              { return num_lost; }
+
+        /// Sets the sync mode on or off. If the port is open the MIDITimer is immediately switched
+        /// to (or from) external clock, otherwise this is done when the port is opened.
+        void                    SetSyncMode(bool on);
+        /// Opens the JACK client, registers the MIDI out port and activates the client (see
+        /// MIDIOutDriver::OpenPort()). In sync mode switches the MIDITimer to external clock.
+        virtual void            OpenPort();
+        /// Deactivates and closes the JACK client (see MIDIOutDriver::ClosePort()), restoring the
+        /// internal MIDITimer clock.
+        virtual void            ClosePort();
+        /// Turns off all the sounding notes (see MIDIOutDriver::AllNotesOff()). If called by the JACK thread
+        /// and the driver is locked by another thread, this is done in the next period.
+        virtual void            AllNotesOff(int chan = -1);
+        /// Processes the message and sends it (see MIDIOutDriver::OutputMessage()). If called by the JACK
+        /// thread, the message is written in the current period buffer without waiting.
+        virtual void            OutputMessage(const MIDITimedMessage& msg);
+        /// If called by the JACK thread during the process callback (i.e.\ by the sequencer in sync mode)
+        /// writes the message in the period buffer at the frame offset corresponding to _sys_time_,
+        /// otherwise queues it for the next period.
+        virtual void            OutputTimedMessage(const MIDITimedMessage& msg, double sys_time);
+
+        /// The max number of messages the JACK thread can put aside when the driver is locked by another
+        /// thread (they are sent in the next period).
+        static const unsigned int MAX_DEFERRED = 256;
+
+    protected:
+        /// Queues the message for the next period, or writes it in the current period buffer if called
+        /// by the JACK thread.
+        virtual void            HardwareMsgOut(const MIDIMessage &msg);
+
+        /// \cond EXCLUDED
+        // The JACK process callback.
+        static int              ProcessCallback(jack_nframes_t nframes, void* p);
+        // Deactivates and closes the JACK client, restoring the internal timer clock.
+        void                    CloseClient();
+        // Sends a processed message from the JACK thread at the given frame offset. It never waits: if
+        // the driver is locked by another thread the message is deferred to the next period.
+        void                    CallbackOutput(const MIDITimedMessage& msg, jack_nframes_t offset);
+        // Sends the messages deferred by the JACK thread, at the start of the period.
+        void                    SendDeferred();
+        // Converts msg into bytes, returns false if it must not be sent.
+        bool                    MsgToBytes(const MIDIMessage& msg);
+        // Writes the bytes at the given frame offset in the current period buffer.
+        void                    WriteToCycle(jack_nframes_t offset);
+
+        std::string             client_name;
+        jack_client_t*          client;
+        jack_port_t*            jack_port;
+        std::atomic<bool>       sync_mode;
+        jack_nframes_t          sample_rate;
+
+        // The driver whose process callback is running in this thread (0 if none): this tells the methods
+        // called by the JACK thread from the others without sharing any variable between threads.
+        static thread_local MIDIJackOutDriver* callback_driver;
+
+        // these are only accessed by the JACK thread during the process callback
+        void*                   cycle_buffer;       // the port buffer of the current period
+        jack_nframes_t          cycle_frames;       // the number of frames in the period
+        jack_nframes_t          last_offset;        // JACK wants events in time order
+        double                  cycle_start;        // the system time of the 1st frame of the period
+        double                  base_time;          // the system time ...
+        jack_nframes_t          base_frame;         // ... corresponding to this frame
+        bool                    base_set;
+        std::vector<MIDITimedMessage>
+                                deferred;           // messages put aside when the driver was locked
+        unsigned int            deferred_notes_off; // channels of an AllNotesOff() put aside (bit mask)
+        std::atomic<unsigned int> num_lost;         // messages lost because the JACK buffer was full
+
+        std::vector<std::vector<unsigned char> >
+                                pending;            // messages waiting for the next period
+        std::mutex              pending_mutex;
+        /// \endcond
+
+    private:
+        std::vector<unsigned char>      bytes;
+};
+
+#endif // __UNIX_JACK__
+
+#endif // _JDKMIDI_JACKDRIVER_H
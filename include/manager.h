@@ -80,6 +80,16 @@ public:
     /// Returns **true** if n is a valid MIDI out port number. If you call this with 0 as argument
     /// and it returns **false** no MIDI out port is present in the system.
     static bool                 IsValidOutPortNumber(unsigned int n);
+    /// Adds a user created MIDIInDriver (as a MIDIShmInDriver) to the manager, which gives it the
+    /// next port number (i.e.\ the value returned by GetNumMIDIIns() before the call). The driver
+    /// must be allocated with new and must not be deleted by the user.
+    /// \return the port number of the new driver
+    static unsigned int         AddInDriver(MIDIInDriver* drv);
+    /// Adds a user created MIDIOutDriver (as a MIDIShmOutDriver) to the manager, which gives it the
+    /// next port number (i.e.\ the value returned by GetNumMIDIOuts() before the call). The driver
+    /// must be allocated with new and must not be deleted by the user.
+    /// \return the port number of the new driver
+    static unsigned int         AddOutDriver(MIDIOutDriver* drv);
     /// Returns the pointer to the (unique) MIDITickComponent in the queue with tPriority PR_SEQ
     /// (0 if not found).
     static MIDISequencer*       GetSequencer();
@@ -24,7 +24,7 @@
 
 
 /// \file
-/// Contains the definition of the class MIDIMatrix.
+/// Contains the definition of the classes MIDIMatrix and MIDINoteBitMatrix.
 
 
 #ifndef _JDKMIDI_MATRIX_H
@@ -33,6 +33,8 @@
 #include "msg.h"
 #include "processor.h"
 
+#include <cstdint>
+
 
 ///
 /// This MIDIProcessor subclass implements a matrix which keeps track of notes on and hold pedal for
@@ -104,6 +106,62 @@ class  MIDIMatrix : public MIDIProcessor {
 };
 
 
+///
+/// A compact version of the MIDIMatrix, which only remembers if a note is sounding or not (without counting
+/// how many times it was started) and the hold pedal status, using a bit for every note. It is used by the
+/// MIDIOutDriver for keeping track of the notes sent to the port, so that AllNotesOff() can send a Note Off
+/// only for the sounding notes: the sounding notes of a channel can be enumerated with GetNextNoteOn(), which
+/// skips 64 silent notes at once.
+///
+class MIDINoteBitMatrix : public MIDIProcessor {
+    public:
+        /// The constructor creates an empty matrix
+                        MIDINoteBitMatrix()                             { Reset(); }
+        /// The destructor
+        virtual        ~MIDINoteBitMatrix() {}
+
+        /// Resets the matrix (no notes on, no pedal hold)
+        virtual void    Reset();
+        /// Processes the given MIDI message updating the matrix. Returns **true** if the message is a
+        /// note, pedal or all notes off message, **false** otherwise.
+        virtual bool    Process(MIDITimedMessage* msg)                  { return Update(*msg); }
+        /// The same as Process(), but it doesn't require a MIDITimedMessage.
+        bool            Update(const MIDIMessage& msg);
+        /// Returns **true** if there are notes on or a hold pedal on any channel.
+        bool            IsEmpty() const                                 { return channel_mask == 0; }
+        /// Returns **true** if there are notes on or a hold pedal on the given channel.
+        /// See \ref NUMBERING.
+        bool            IsChannelActive(int chan) const                 { return (channel_mask >> chan) & 1; }
+        /// Returns **true** if the given note is sounding on the given channel.
+        /// See \ref NUMBERING.
+        bool            IsNoteOn(int chan, int note) const
+                                    { return (notes[chan][note >> 6] >> (note & 63)) & 1; }
+        /// Returns **true** if pedal is holding on given channel.
+        /// See \ref NUMBERING.
+        bool            GetHoldPedal(int chan) const                    { return (pedal_mask >> chan) & 1; }
+        /// Returns the number of notes on for given channel.
+        /// See \ref NUMBERING.
+        int             GetChannelCount(int chan) const;
+        /// Returns the first sounding note on the given channel with value >= _note_, or -1 if there
+        /// are no other notes on. You can enumerate all sounding notes of a channel with a loop like this:
+        /// \code
+        /// for (int note = m.GetNextNoteOn(chan, 0); note != -1; note = m.GetNextNoteOn(chan, note + 1))
+        /// \endcode
+        /// See \ref NUMBERING.
+        int             GetNextNoteOn(int chan, int note) const;
+        /// Clear the notes and the pedal on the given channel.
+        /// See \ref NUMBERING.
+        void            ClearChannel(int chan);
+
+    private:
+        void            UpdateChannelMask(int chan);
+
+        uint64_t        notes[16][2];                   // A bit for every note (16 channels x 128 notes)
+        uint16_t        channel_mask;                   // A bit for every channel with notes or pedal on
+        uint16_t        pedal_mask;                     // A bit for every channel with pedal on
+};
+
+
 #endif
 
 
@@ -30,6 +30,8 @@
 #ifndef _JDKMIDI_MIDI_H
 #define _JDKMIDI_MIDI_H
 
+#include <cstdint>
+
 
 /// \addtogroup GLOBALS
 ///@{
@@ -260,6 +262,31 @@ enum : unsigned char {
     META_SEQUENCER_SPECIFIC = 0x7F
 };
 ///@}
+
+
+/// \name Message categories
+///@{
+
+/// These are the bits returned by MIDIMessage::Classify(): you can test many categories with a single call.
+/// Note on and control change bits are refined with the data bytes (a note on with velocity 0 is a note off,
+/// a control change with controller >= 0x78 is a channel mode message).
+enum : uint16_t {
+    MSG_CHANNEL             = 0x0001,   ///< Any channel message (status 0x80 ... 0xef)
+    MSG_NOTE_ON             = 0x0002,   ///< Note on (with velocity > 0)
+    MSG_NOTE_OFF            = 0x0004,   ///< Note off (or note on with velocity 0)
+    MSG_POLY_PRESSURE       = 0x0008,   ///< Polyphonic pressure
+    MSG_CONTROL_CHANGE      = 0x0010,   ///< Control change (not channel mode)
+    MSG_CHANNEL_MODE        = 0x0020,   ///< Channel mode (a control change with controller >= 0x78)
+    MSG_PROGRAM_CHANGE      = 0x0040,   ///< Program change
+    MSG_CHANNEL_PRESSURE    = 0x0080,   ///< Channel pressure
+    MSG_PITCH_BEND          = 0x0100,   ///< Pitch bend
+    MSG_SYSTEM              = 0x0200,   ///< Any system message (status 0xf0 ... 0xff), including sysex and meta
+    MSG_SYSEX               = 0x0400,   ///< System exclusive
+    MSG_META                = 0x0800,   ///< Meta event
+    MSG_SERVICE             = 0x1000,   ///< NoOp or beat marker (internal service messages)
+    MSG_NOTE                = MSG_NOTE_ON | MSG_NOTE_OFF    ///< Note on or note off
+};
+///@}
 ///@}
 
 
@@ -24,7 +24,7 @@
 
 
 /// \file
-/// Contains the definition of the classes MIDIMessage and MIDITimedMessage.
+/// Contains the definition of the classes MIDIShortMsg, MIDIMessage and MIDITimedMessage.
 
 
 #ifndef _JDKMIDI_MSG_H
@@ -36,6 +36,60 @@
 #include <string>
 
 
+///
+/// The raw bytes of a channel message, ready to be sent. This is a literal type and its static factory methods
+/// are constexpr, so fixed messages can be built at compile time; it can be implicitly converted into a
+/// MIDIMessage or a MIDITimedMessage without any computation, so you can write for example
+/// \code
+/// driver->OutputMessage(MIDIShortMsg::NoteOn(chan, note, vel));
+/// \endcode
+///
+struct MIDIShortMsg {
+        /// Returns a note on message.
+        static constexpr MIDIShortMsg   NoteOn(unsigned char chan, unsigned char note, unsigned char vel)
+                                            { return Make(NOTE_ON, chan, note, vel); }
+        /// Returns a note off message (with the NOTE_OFF status, see also MIDIMessage::UseNoteOnv0ForOff()).
+        static constexpr MIDIShortMsg   NoteOff(unsigned char chan, unsigned char note, unsigned char vel = 0)
+                                            { return Make(NOTE_OFF, chan, note, vel); }
+        /// Returns a polyphonic pressure message.
+        static constexpr MIDIShortMsg   PolyPressure(unsigned char chan, unsigned char note, unsigned char press)
+                                            { return Make(POLY_PRESSURE, chan, note, press); }
+        /// Returns a control change message.
+        static constexpr MIDIShortMsg   ControlChange(unsigned char chan, unsigned char ctrl, unsigned char val)
+                                            { return Make(CONTROL_CHANGE, chan, ctrl, val); }
+        /// Returns a program change message.
+        static constexpr MIDIShortMsg   ProgramChange(unsigned char chan, unsigned char prog)
+                                            { return Make(PROGRAM_CHANGE, chan, prog, 0, 2); }
+        /// Returns a channel pressure message.
+        static constexpr MIDIShortMsg   ChannelPressure(unsigned char chan, unsigned char press)
+                                            { return Make(CHANNEL_PRESSURE, chan, press, 0, 2); }
+        /// Returns a pitch bend message; _val_ is in the range -8192 ... 8191.
+        static constexpr MIDIShortMsg   PitchBend(unsigned char chan, short val)
+                                            { return Make(PITCH_BEND, chan, (val + 8192) & 0x7f, ((val + 8192) >> 7) & 0x7f); }
+        /// Returns an all notes off message.
+        static constexpr MIDIShortMsg   AllNotesOff(unsigned char chan)
+                                            { return Make(CONTROL_CHANGE, chan, C_ALL_NOTES_OFF, 0); }
+        /// Returns an all sound off message.
+        static constexpr MIDIShortMsg   AllSoundOff(unsigned char chan)
+                                            { return Make(CONTROL_CHANGE, chan, C_ALL_SOUND_OFF, 0); }
+
+        /// Returns a pointer to the bytes of the message.
+        const unsigned char*            GetBytes() const        { return bytes; }
+        /// Returns the number of bytes of the message.
+        unsigned char                   GetLength() const       { return length; }
+
+        unsigned char                   bytes[3];   ///< Status and data bytes
+        unsigned char                   length;     ///< The number of bytes used
+
+    private:
+        static constexpr MIDIShortMsg   Make(unsigned char type, unsigned char chan, unsigned char b1,
+                                             unsigned char b2, unsigned char len = 3)
+                                            { return MIDIShortMsg { { (unsigned char)(type | (chan & 0x0f)),
+                                                                      (unsigned char)(b1 & 0x7f),
+                                                                      (unsigned char)(b2 & 0x7f) }, len }; }
+};
+
+
 ///
 /// Stores data representing a MIDI event message.
 /// It consists of a status byte, three data bytes for subsequent data and a pointer to a MIDISystemExclusive
@@ -45,27 +99,52 @@
 /// enum values for MIDI messages data.
 /// In addition to MIDI messages, the MIDIMessage can also contain two types of internal service messages:
 /// the NoOp (a null, not initialized message) and the beat marker, used by the MIDISequencer as metronome click.
+/// \note The class has no virtual methods, so that a MIDITimedMessage (which is the element of the MIDITrack
+/// event vector) takes only 16 bytes on common 64 bit platforms: don't delete a MIDITimedMessage through a
+/// MIDIMessage pointer.
 ///
 class 	MIDIMessage {
     public:
         /// Creates a a NoOp MIDIMessage (an undefined MIDI message, which will be ignored when playing).
                                 MIDIMessage();
-        /// The copy constructor. If the target message has a MIDISystemExclusive object it is duplicated,
-        /// so every MIDIMessage has its own object.
+        /// The copy constructor. If the target message has a MIDISystemExclusive object it is shared
+        /// between the two messages, and duplicated only when one of them modifies it (see EditSysEx()).
                                 MIDIMessage(const MIDIMessage &msg);
+        /// The move constructor. The MIDISystemExclusive object (if any) is not duplicated, but taken from _msg_,
+        /// which becomes a NoOp.
+                                MIDIMessage(MIDIMessage &&msg) noexcept;
+        /// Creates a channel message from its raw bytes (see MIDIShortMsg). This is constexpr, so static
+        /// MIDIMessage objects built from constant MIDIShortMsg are initialized at compile time.
+        constexpr               MIDIMessage(const MIDIShortMsg& msg) :
+                                    sysex(0), status(msg.bytes[0]), byte1(msg.length > 1 ? msg.bytes[1] : 0),
+                                    byte2(msg.length > 2 ? msg.bytes[2] : 0), byte3(0) {}
         /// The destructor.
-        virtual                 ~MIDIMessage();
+                                ~MIDIMessage();
         /// Resets the message and frees the MIDISystemExclusive pointer; the message becomes a NoOp.
-        virtual void            Clear();
-        /// Frees the MIDISystemExclusive pointer without changing other bytes.
+        void                    Clear();
+        /// Frees the MIDISystemExclusive pointer without changing other bytes (the object is deleted only if
+        /// it is not shared with other messages).
         void                    ClearSysEx();
-        /// The assignment operator. It primarily frees the old MIDISystemExclusive object if it was allocated,
-        /// then duplicates the (eventual) new MIDISystemExclusive, so every MIDIBigMessage has its own object.
+        /// The assignment operator. It primarily frees the old MIDISystemExclusive object if it was allocated
+        /// (and not shared with other messages), then shares the (eventual) new MIDISystemExclusive with _msg_.
         const MIDIMessage&      operator= (const MIDIMessage &msg);
+        /// The move assignment operator. It frees the old MIDISystemExclusive object if it was allocated,
+        /// then takes the one of _msg_ (if any) without duplicating it; _msg_ becomes a NoOp.
+        const MIDIMessage&      operator= (MIDIMessage &&msg) noexcept;
 
         /// Returns the length in bytes of the entire message. It can return -1 for messages whose lrngth is
         /// undefined /for example sysex).
-        int	                    GetLength() const;
+        int	                    GetLength() const           { return status_info[status].length; }
+        /// Returns the categories of the message as an OR of the \ref MSG_CHANNEL ... \ref MSG_SERVICE bits.
+        /// This is a table lookup, so you can use it in loops instead of calling many IsXXX() methods.
+        uint16_t                Classify() const {
+                                    uint16_t cat = status_info[status].category;
+                                    if ((cat & MSG_NOTE_ON) && byte2 == 0)
+                                        cat ^= MSG_NOTE_ON | MSG_NOTE_OFF;
+                                    else if ((cat & MSG_CONTROL_CHANGE) && byte1 >= C_ALL_SOUND_OFF)
+                                        cat ^= MSG_CONTROL_CHANGE | MSG_CHANNEL_MODE;
+                                    return cat;
+                                }
         /// Returns the status byte of the message. If the message is a channel message this contains the message
         /// type in the top 4 bits and the channel in the bottom 4. See \ref MIDIENUM for status bytes
         unsigned char	        GetStatus() const	        { return (unsigned char)status;	}
@@ -83,10 +162,13 @@ class 	MIDIMessage {
         unsigned char	        GetByte2() const	        { return byte2;	}
         /// Accesses the raw byte 3 of the message.
         unsigned char	        GetByte3() const	        { return byte3;	}
-        /// Returns a pointer to the MIDISystemExclusive object (0 if it is not allocated).
-        MIDISystemExclusive*    GetSysEx()                  { return sysex; }
-        /// Returns a pointer to the MIDISystemExclusive object (0 if it is not allocated).
+        /// Returns a pointer to the MIDISystemExclusive object (0 if it is not allocated), for reading it.
+        /// This never copies the object (see EditSysEx()).
         const MIDISystemExclusive*GetSysEx() const          { return sysex; }
+        /// Returns a pointer to the MIDISystemExclusive object (0 if it is not allocated), which you can use
+        /// for modifying it. If the object was shared with other messages it is duplicated first, so the other
+        /// messages are not affected: if you only want to read it use GetSysEx(), which is cheaper.
+        MIDISystemExclusive*    EditSysEx();
         /// If the message is a note on, note off, or poly aftertouch message, returns the note number.
         unsigned char	        GetNote() const		        { return byte1;	}
         /// If the message is a note on, note off, or poly aftertouch message, returns the velocity (or pressure).
@@ -123,7 +205,7 @@ class 	MIDIMessage {
 
         /// Returns **true** if the message is some sort of channel message.
         /// You can then call GetChannel() and GetType() for further information.
-        bool	                IsChannelMsg() const        { return (status >= 0x80) && (status < 0xf0); }
+        bool	                IsChannelMsg() const        { return status_info[status].category & MSG_CHANNEL; }
         /// Returns **true** if the message is a note on message (status == NOTE_ON and velocity > 0).
         /// You can then call GetChannel(), GetNote() and GetVelocity() for further information.
         bool	                IsNoteOn() const            { return ((status & 0xf0) == NOTE_ON) && byte2; }
@@ -330,9 +412,17 @@ class 	MIDIMessage {
 
         /// Returns a human readable ascii string describing the message content.
         /// \param chan_from_1 if **false** channels are numbered 0 ... 15, otherwise 1 ... 16. See \ref NUMBERING
-        virtual std::string     MsgToText(bool chan_from_1 = false) const;
+        std::string             MsgToText(bool chan_from_1 = false) const;
+        /// Writes the same text of MsgToText() into a buffer given by the caller, without allocating memory (you
+        /// can use this for logging or dumping a lot of messages). The text is truncated if it is too long, and
+        /// always null terminated.
+        /// \param buf the buffer
+        /// \param size the size of the buffer; a size of TEXT_BUFFER_SIZE is always enough
+        /// \param chan_from_1 see above
+        /// \return the number of characters written (without the terminating null)
+        unsigned int            MsgToText(char* buf, unsigned int size, bool chan_from_1 = false) const;
         /// Allocates a MIDISystemExclusive object, with a buffer of given max size.
-        ///The buffer is initially empty and can be accessed with GetSysEx(). An eventual old object is freed.
+        ///The buffer is initially empty and can be filled through EditSysEx(). An eventual old object is freed.
         void                    AllocateSysEx(unsigned int len);
         /// Copies the given MIDISystemExclusive object into the message without changing other bytes.
         /// An eventual old object is freed.
@@ -344,6 +434,11 @@ class 	MIDIMessage {
         /// message or a NOTE_ON with velocity 0.
         /// The default is **false** (NOTE_OFF messages). If you want to use the other form call this with **true**.
         static void             UseNoteOnv0ForOff(bool f)           { use_note_onv0 = f; }
+        /// Returns **true** if SetNoteOff() sets a note on message with velocity 0 (see UseNoteOnv0ForOff()).
+        static bool             GetNoteOnv0ForOff()                 { return use_note_onv0; }
+
+        /// A buffer size always large enough for the text written by MsgToText().
+        static const unsigned int TEXT_BUFFER_SIZE = 128;
 
         /// \cond EXCLUDED
         /// Status and byte1 for non MIDI messages (internal use).
@@ -355,11 +450,42 @@ class 	MIDIMessage {
     protected:
 
         /// \cond EXCLUDED
+        // The category bits (refined by Classify()) and the length of a message with given status.
+        struct StatusInfo {
+            uint16_t            category;
+            signed char         length;
+        };
+        static constexpr uint16_t ChanCategory(unsigned int type) {
+            return MSG_CHANNEL | (type == NOTE_OFF ? MSG_NOTE_OFF : type == NOTE_ON ? MSG_NOTE_ON :
+                                  type == POLY_PRESSURE ? MSG_POLY_PRESSURE :
+                                  type == CONTROL_CHANGE ? MSG_CONTROL_CHANGE :
+                                  type == PROGRAM_CHANGE ? MSG_PROGRAM_CHANGE :
+                                  type == CHANNEL_PRESSURE ? MSG_CHANNEL_PRESSURE : MSG_PITCH_BEND);
+        }
+        static constexpr StatusInfo GetStatusInfo(unsigned int st) {
+            return st == STATUS_SERVICE ? StatusInfo { MSG_SERVICE, 0 } :
+                   st < 0x80 ? StatusInfo { 0, 0 } :
+                   st < 0xf0 ? StatusInfo { ChanCategory(st & 0xf0), (signed char)((st & 0xe0) == 0xc0 ? 2 : 3) } :
+                   StatusInfo { (uint16_t)(MSG_SYSTEM | (st == SYSEX_START ? MSG_SYSEX : 0) |
+                                                        (st == META_EVENT ? MSG_META : 0)),
+                                SysLength(st) };
+        }
+        // the same values of sys_msg_len[]
+        static constexpr signed char SysLength(unsigned int st) {
+            return st == SYSEX_START || st == META_EVENT ? -1 :
+                   st == SONG_POSITION ? 3 :
+                   st == MTC || st == SONG_SELECT ? 2 :
+                   st == 0xf4 || st == 0xf5 || st == SYSEX_END || st == 0xfd ? 0 : 1;
+        }
+        static const StatusInfo status_info[256];
+
+        // the pointer is the first member, so the derived MIDITimedMessage can put its time in the
+        // padding after the data bytes
+        MIDISystemExclusive*    sysex;          // The sysex pointer.
         unsigned char	        status;         // The status byte.
         unsigned char	        byte1;          // 1st data byte.
         unsigned char	        byte2;          // 2nd data byte.
         unsigned char	        byte3;		    // 3rd data byte (only used for some meta-events).
-        MIDISystemExclusive*    sysex;          // The sysex pointer.
         static bool             use_note_onv0;  // This flag influences the SetNoteOff() method behavior.
         /// \endcond
 };
@@ -386,27 +512,46 @@ class 	MIDITimedMessage : public MIDIMessage {
                                 MIDITimedMessage(const MIDITimedMessage &msg);
         /// Copy constructor (sets the time to 0). \see MIDIMessage::(MIDIMessage()
                                 MIDITimedMessage(const MIDIMessage &msg);
+        /// Move constructor. \see MIDIMessage::MIDIMessage(MIDIMessage&&)
+                                MIDITimedMessage(MIDITimedMessage &&msg) noexcept;
+        /// Move constructor (sets the time to 0). \see MIDIMessage::MIDIMessage(MIDIMessage&&)
+                                MIDITimedMessage(MIDIMessage &&msg) noexcept;
+        /// Creates a channel message with time 0 from its raw bytes. \see MIDIMessage::MIDIMessage(const MIDIShortMsg&)
+        constexpr               MIDITimedMessage(const MIDIShortMsg& msg) : MIDIMessage(msg), time(0) {}
         /// Destructor.
                                 ~MIDITimedMessage();
         /// Resets the message, frees the MIDISystemExclusive pointer and sets the time to 0.
         /// The message becomes a NoOp.
-        virtual void            Clear();
+        void                    Clear();
 
         /// Assignment operator. \see MIDIMessage::operator=()
         const MIDITimedMessage &operator= (const MIDITimedMessage &msg);
         /// Assignment operator (sets the time to 0). \see MIDIMessage::operator=()
         const MIDITimedMessage &operator= (const MIDIMessage &msg);
+        /// Move assignment operator. \see MIDIMessage::operator=(MIDIMessage&&)
+        const MIDITimedMessage &operator= (MIDITimedMessage &&msg) noexcept;
+        /// Move assignment operator (sets the time to 0). \see MIDIMessage::operator=(MIDIMessage&&)
+        const MIDITimedMessage &operator= (MIDIMessage &&msg) noexcept;
+        /// Assignment from raw bytes (sets the time to 0). \see MIDIShortMsg
+        const MIDITimedMessage &operator= (const MIDIShortMsg &msg)
+                                                                    { return *this = MIDITimedMessage(msg); }
 
         /// Returns a human readable ascii string describing the message content.
         /// \param chan_from_1 if zero channels are numbered 0 ... 15, otherwise 1 ... 16. See \ref NUMBERING
-        virtual std::string     MsgToText(unsigned char chan_from_1 = 0) const;
+        std::string             MsgToText(unsigned char chan_from_1 = 0) const;
+        /// Writes the same text of MsgToText() into a buffer given by the caller, without allocating memory.
+        /// \see MIDIMessage::MsgToText(char*, unsigned int, bool)
+        unsigned int            MsgToText(char* buf, unsigned int size, unsigned char chan_from_1 = 0) const;
 
         /// Returns the MIDIClockTime associated with the message.
         MIDIClockTime	        GetTime() const                 { return time; }
-        /// Sets the MIDIClockTime associated with the message.
-        void	                SetTime(MIDIClockTime t)        { time = t; }
-        /// Adds the given amount to the associated time.
-        void                    AddTime(MIDIClockTime t)        { time += t; }
+        /// Sets the MIDIClockTime associated with the message (values greater than TIME_INFINITE are
+        /// set to TIME_INFINITE).
+        void	                SetTime(MIDIClockTime t)
+                                    { time = (uint32_t)(t > TIME_INFINITE ? TIME_INFINITE : t); }
+        /// Adds the given amount to the associated time (the result is limited to TIME_INFINITE).
+        void                    AddTime(MIDIClockTime t)
+                                    { time = (uint32_t)(t > TIME_INFINITE - time ? TIME_INFINITE : time + t); }
         /// Subtracts the given amount from the associated time (if _t_ is greater set the time to 0).
         void                    SubTime(MIDIClockTime t)        { time = (t > time ? 0 : time - t); }
 
@@ -448,7 +593,8 @@ class 	MIDITimedMessage : public MIDIMessage {
 
     protected:
 
-        MIDIClockTime	        time;           ///< The time of the event
+        uint32_t	            time;           ///< The time of the event (MIDIClockTime values never exceed
+                                                ///< TIME_INFINITE, so 32 bits are enough)
 };
 
 #endif
@@ -34,6 +34,10 @@
 #include "track.h"
 
 #include <vector>
+#include <string>
+#include <deque>
+#include <mutex>
+#include <atomic>
 
 
 class MIDIEditMultiTrack;       // forward declaration
@@ -152,13 +156,42 @@ class MIDIMultiTrack {
         /// Inserts the event _msg_ in the track _trk_num_. See MIDITrack::InsertEvent() for details.
         /// \return **true** if the event was effectively inserted
         bool                        InsertEvent(unsigned int trk_num,  const MIDITimedMessage& msg, tInsMode _ins_mode = INSMODE_DEFAULT);
+        /// The same as above, but _msg_ is moved into the track instead of being copied.
+        bool                        InsertEvent(unsigned int trk_num,  MIDITimedMessage&& msg, tInsMode _ins_mode = INSMODE_DEFAULT);
         /// Inserts a Note On and a Note Off event into the track _trk_num_. See MIDITrack::InsertNote() for details.
         bool                        InsertNote(unsigned int trk_num, const MIDITimedMessage& msg,
                                             MIDIClockTime len, tInsMode _ins_mode = INSMODE_DEFAULT);
+        /// The same as above, but _msg_ is moved into the track instead of being copied.
+        bool                        InsertNote(unsigned int trk_num, MIDITimedMessage&& msg,
+                                            MIDIClockTime len, tInsMode _ins_mode = INSMODE_DEFAULT);
         /// Deletes the event _msg_ from the track _trk_num_. See MIDITrack::DeleteEvent() for details.
         bool                        DeleteEvent(unsigned int trk_num,  const MIDITimedMessage& msg);
         /// Deletes the note _msg_ (_msg_ must be a Note On) from the track _trk_num. See MIDITrack::DeleteNote() for details.
         bool                        DeleteNote(unsigned int trk_num, const MIDITimedMessage& msg);
+        /// Stores a copy of the texts of all the text meta-messages of the tracks, so they can be got with
+        /// FindText(). Every different text is stored only once, and the texts already stored are kept (the
+        /// pointers returned by FindText() remain valid). The MIDISequencer calls this when it is reset and in
+        /// MIDISequencer::UpdateStatus(), i.e.\ when the multitrack is loaded or edited, not during the playback.
+        /// \warning Don't call this while the multitrack is played by a MIDISequencer.
+        void                        InternTexts();
+        /// Returns a pointer to the copy of the text of the text meta-message _msg_ stored by InternTexts().
+        /// This only looks up the texts, without locking or allocating memory, so it can be called by the
+        /// sequencer for every marker or track name during the playback. The returned string remains valid
+        /// until the multitrack is reset, cleared, assigned or destroyed. Returns a pointer to empty_text
+        /// if _msg_ is not a text meta-message or its text was not stored.
+        const std::string*          FindText(const MIDIMessage& msg) const;
+        /// Applies the operations of _tr_ to all the events of all the tracks (see MIDITrack::Transform()). The
+        /// tracks are independent, so they are processed in parallel by _num_threads_ threads (the calling
+        /// thread included): the default 0 uses one thread for every processor core.
+        /// \warning Don't call this while the multitrack is played by a MIDISequencer.
+        void                        Transform(const MIDITransform& tr, unsigned int num_threads = 0);
+        /// Deletes the redundant events of all the tracks (see MIDITrack::Compact()). Every track is compacted
+        /// independently, so a value repeated in another track is not considered redundant.
+        /// \return the number of deleted events.
+        unsigned int                Compact(MIDIProcessorCompactor& comp);
+
+        /// An empty string, returned by FindText() for messages without text.
+        static const std::string    empty_text;
 
 
         void                        EditCopy(MIDIClockTime start, MIDIClockTime end, int tr_start,
@@ -178,7 +211,18 @@ class MIDIMultiTrack {
         unsigned int 	            clks_per_beat;      ///< The common clock per beat timing parameter for all tracks
                                                         ///< (this is the number of MIDI ticks for a quarter note).
         /// \cond EXCLUDED
+        // The procedure of the threads started by Transform(): transforms the tracks not yet taken by others.
+        static void                 TransformProc(MIDIMultiTrack* multi, const MIDITransform* tr,
+                                                  std::atomic<unsigned int>* next_track);
+
         std::vector<MIDITrack*>     tracks;             // The array of pointers to the MIDITrack objects
+        // Deletes the interned texts.
+        void                        ClearTexts();
+
+        std::deque<std::string>     texts;              // The interned texts (see InternTexts())
+        std::vector<const std::string*>
+                                    text_index;         // The interned texts, sorted for FindText()
+        std::mutex                  texts_mutex;        // InternTexts() may be called by different threads
         /// \endcond
 };
 
@@ -25,7 +25,8 @@
 
 /// \file
 /// Contains the definition of the pure virtual MIDIProcessor class and its specializations
-/// MIDIMultiProcessor, MIDIProcessorTransposer, MIDIProcessorRechannelizer, MIDIProcessorPrinter.
+/// MIDIMultiProcessor, MIDIProcessorTransposer, MIDIProcessorRechannelizer, MIDIProcessorPrinter,
+/// MIDIProcessorCompactor.
 /// These are devices that can manipulate a MIDITimedMessage.
 
 
@@ -211,4 +212,82 @@ class MIDIProcessorPrinter : public MIDIProcessor {
 };
 
 
+///
+/// A MIDIProcessor which removes redundant messages from a stream of controller, pitch bend and channel
+/// pressure messages: a message is dropped if it repeats the last value sent on its channel, if it changes
+/// it by no more than a given tolerance or if it comes too early after the last one (you can set these for
+/// every controller). Program changes repeating the last program of the channel (with no bank select in the
+/// meanwhile) are dropped too. Values at the ends of the range (and the center of the bender) are never
+/// thinned, so a controller ramp or a bend always reaches its final position.
+///
+/// You can use it in real time (for example as the processor of a MIDIOutDriver or of a sequencer track) to
+/// thin dense live streams, or pass it to MIDITrack::Compact() or MIDIMultiTrack::Compact() to remove the
+/// same messages from the stored events; the latter also deletes notes with zero length.
+///
+/// With the default settings only exactly repeated values are removed, which never changes what you hear;
+/// tolerances and spacings greater than 0 make the thinning lossy.
+/// \note Bank select, RPN, NRPN and data entry controllers are never thinned, as their messages are meaningful
+/// only in sequence, and a sysex or a reset all controllers message makes the processor forget the last values.
+///
+class MIDIProcessorCompactor : public MIDIProcessor {
+    public:
+        /// The constructor.
+                                        MIDIProcessorCompactor();
+        /// Resets to the default settings (only repeated values are removed) and forgets the last values.
+        virtual void                    Reset();
+        /// Forgets the last values sent, leaving the settings unchanged: the next message of every kind will
+        /// be always accepted. You should call this when the flow of messages restarts (for example when the
+        /// sequencer jumps to another time).
+        void                            ResetValues();
+        /// Returns the tolerance of the controller _kind_ (0 ... 127, or one of BENDER, CHAN_PRESSURE).
+        int                             GetTolerance(int kind) const                { return tolerance[kind]; }
+        /// Returns the minimum spacing of the controller _kind_ (0 ... 127, or one of BENDER, CHAN_PRESSURE).
+        unsigned long                   GetMinSpacing(int kind) const               { return min_spacing[kind]; }
+        /// Returns **true** if the spacings are measured in milliseconds of system time (see SetRealTime()).
+        bool                            GetRealTime() const                         { return real_time; }
+        /// Returns **true** if MIDITrack::Compact() removes the notes with zero length.
+        bool                            GetRemoveEmptyNotes() const                 { return remove_empty_notes; }
+        /// Sets the thinning of a controller.
+        /// \param kind the controller number (0 ... 127), or one of BENDER, CHAN_PRESSURE
+        /// \param tol the messages which change the last value by no more than _tol_ are dropped (for the
+        /// bender the values range from -8192 to 8191)
+        /// \param spacing the messages which come less than _spacing_ after the last one (in MIDI ticks, or in
+        /// milliseconds if GetRealTime() is **true**) are dropped
+        void                            SetTolerance(int kind, int tol, unsigned long spacing = 0)
+                                                        { tolerance[kind] = tol; min_spacing[kind] = spacing; }
+        /// Sets the same tolerance and minimum spacing for all the controllers (but not for the bender and the
+        /// channel pressure).
+        void                            SetAllTolerances(int tol, unsigned long spacing = 0);
+        /// If _on_ is **true** Process() ignores the time of the messages and measures the spacings with
+        /// the system time in milliseconds (use this for the processor of a driver). The default is **false**
+        /// (spacings are measured in MIDI ticks with the message times).
+        void                            SetRealTime(bool on)                        { real_time = on; }
+        /// Sets whether MIDITrack::Compact() removes the notes with zero length (the default is **true**).
+        void                            SetRemoveEmptyNotes(bool on)                { remove_empty_notes = on; }
+        /// Checks the message _msg_ at the given time, remembering its value if it is accepted. This is the
+        /// algorithm used both by Process() and MIDITrack::Compact().
+        /// \return **false** if _msg_ is redundant and can be dropped, **true** otherwise.
+        bool                            Check(const MIDIMessage& msg, unsigned long time);
+        /// The Process() method. It leaves the message unchanged and returns **false** if it is redundant,
+        /// **true** otherwise (see Check()).
+        virtual bool                    Process(MIDITimedMessage *msg);
+        /// These are the values to be given as _kind_ parameter to the SetTolerance() method, besides the
+        /// controller numbers.
+        enum { BENDER = 128, CHAN_PRESSURE = 129, NUM_KINDS = 130 };
+
+    protected:
+        /// \cond EXCLUDED
+        int                             tolerance[NUM_KINDS];           // The tolerance of every controller
+        unsigned long                   min_spacing[NUM_KINDS];         // The minimum spacing of every controller
+        bool                            real_time;                      // Spacings in ms of system time
+        bool                            remove_empty_notes;             // Compact() removes zero length notes
+        int                             last_values[16][NUM_KINDS];     // The last accepted values (NO_VALUE if none)
+        unsigned long                   last_times[16][NUM_KINDS];      // The times of the last accepted values
+        int                             last_programs[16];              // The last accepted program (NO_VALUE if none)
+
+        enum { NO_VALUE = -100000 };
+        /// \endcond
+};
+
+
 #endif
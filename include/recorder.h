@@ -162,8 +162,7 @@ class RecNotifier: public MIDISequencerGUINotifier {
         unsigned char                   beat_note;          // The MIDI note number for the ordinary beat click
         unsigned int                    port;               // The out port id
         unsigned char                   chan;               // The MIDI channel for sound output
-        MIDIMessage                     on_msg;
-        MIDIMessage                     off_msg;
+        MIDITimedMessage                off_msg;            // The note off for the last click
         unsigned char                   num_beats;
         MIDISequencerGUINotifier*       other_notifier;
 };
@@ -69,7 +69,8 @@ class MIDISequencerTrackState {
 
         int16_t         program;		    ///< the current program change, or -1 if undefined
         int16_t         bender_value;		///< the last seen bender value
-        std::string     track_name;	        ///< the track name
+        const std::string* track_name;      ///< the track name (interned by the MIDIMultiTrack, see
+                                            ///< MIDIMultiTrack::FindText())
         bool            notes_are_on;       ///< true if there are notes currently on
         MIDIMatrix      note_matrix;        ///< to keep track of all notes on
         int16_t         control_values[C_ALL_NOTES_OFF];
@@ -152,7 +153,8 @@ class MIDISequencerState : public MIDIProcessor {
         unsigned char           timesig_denominator;///< The denominator of current time signature
         signed char             keysig_sharpflat;   ///< The current key signature accidents (
         unsigned char           keysig_mode;        ///< Major mode (0) or minor (1)
-        std::string             marker_text;        ///< The current marker
+        const std::string*      marker_text;        ///< The current marker (interned by the MIDIMultiTrack, see
+                                                    ///< MIDIMultiTrack::FindText())
         std::vector<MIDISequencerTrackState*>
                                 track_states;       ///< A track state for every track
         int                     last_event_track;   ///< Internal use
@@ -447,7 +449,8 @@ class MIDISequencer : public MIDITickComponent {
         /// state after an edit in the multitrack (adding, deleting or editing events, for changes in the track
         /// structure see InsertTrack(), DeleteTrack() and MoveTrack()). If you have edited the multitrack, call
         /// this before moving time, getting events or playing.
-        virtual void                    UpdateStatus()  { GoToTime(state.cur_clock); }
+        /// It also stores the texts of the new text events (see MIDIMultiTrack::InternTexts()).
+        virtual void                    UpdateStatus();
 
         // Inherited from MIDITICK
         /// Starts the sequencer playing from the current time.
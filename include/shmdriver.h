@@ -0,0 +1,209 @@
+/*
+ *   NiCMidi - A C++ Class Library for MIDI
+ *
+ *   Copyright (C) 2021, 2022  Nicola Cassetta
+ *   https://github.com/ncassetta/NiCMidi
+ *
+ *   This file is part of NiCMidi.
+ *
+ *   NiCMidi is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   NiCMidi is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with NiCMidi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/// \file
+/// Contains the definition of the classes MIDIShmOutDriver and MIDIShmInDriver, used to exchange
+/// MIDI messages between processes running on the same machine through a POSIX shared memory ring.
+
+
+#ifndef _JDKMIDI_SHMDRIVER_H
+#define _JDKMIDI_SHMDRIVER_H
+
+#include "driver.h"
+
+#ifndef WIN32
+
+#include <atomic>
+#include <thread>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+// EXCLUDED FROM DOCUMENTATION BECAUSE UNDOCUMENTED
+// A ring of fixed size records mapped in a POSIX shared memory object. Only one process (the one
+// which owns the MIDIShmOutDriver) writes into the ring, while any number of processes can read
+// from it, each of them with its own read cursor. A reader which is too slow loses the older
+// messages (as in the MIDIRawMessageQueue). Messages longer than a record (sysex) are split over
+// consecutive records, which are published all together. On Linux readers sleep on a futex and
+// are woken by the writer, otherwise they poll the ring every msec.
+class MIDIShmRing {
+    public:
+        // Creates the object, without opening the shared memory. name is the name of the POSIX
+        // shared memory object (it must begin with a '/'), num_records is the number of messages
+        // the ring can hold.
+                                MIDIShmRing(const std::string& name, unsigned int num_records);
+        // Unmaps the shared memory.
+                                ~MIDIShmRing();
+
+        // Creates (if needed) and maps the shared memory object. Returns **true** if the ring
+        // is ready (a zero filled object is a valid empty ring, so the writer and the readers can
+        // be started in any order).
+        bool                    Open();
+        // Unmaps the shared memory object (it is not removed from the system, see Unlink()).
+        void                    Close();
+        // Returns **true** if the shared memory is mapped.
+        bool                    IsOpen() const                  { return header != 0; }
+        // Returns the name of the shared memory object.
+        const std::string&      GetName() const                 { return name; }
+        // Removes the shared memory object from the system.
+        void                    Unlink();
+
+        // Writes the given bytes into the ring (using more records if len > RECORD_LENGTH) and wakes
+        // the waiting readers. Returns **false** if the message doesn't fit in the whole ring (and so
+        // it is not written).
+        bool                    Write(const unsigned char* data, unsigned int len);
+        // Moves the read cursor after the last written message.
+        void                    Sync();
+        // Reads the next message into data (which is resized) and returns its length, or 0 if there
+        // are no new messages. Messages partially overwritten by the writer are skipped.
+        unsigned int            Read(std::vector<unsigned char>& data);
+        // Waits until new messages are available or timeout_ms msecs are elapsed. Returns **true**
+        // if there are new messages.
+        bool                    Wait(unsigned int timeout_ms);
+
+        // The number of message bytes in a record (longer messages use more records).
+        static const unsigned int RECORD_LENGTH = 54;
+
+    protected:
+        // flags in the high bits of Record::len
+        enum { LEN_MASK = 0x00ff, CONTINUED = 0x4000, MORE = 0x8000 };
+        struct Record {
+            std::atomic<uint64_t>   rec_seq;        // 2 * count + 1 while writing, 2 * count + 2 when done
+            uint16_t                len;            // the bytes in data, ORed with CONTINUED and MORE
+            unsigned char           data[RECORD_LENGTH];
+        };
+        struct Header {
+            std::atomic<uint32_t>   num_records;
+            std::atomic<uint32_t>   wake_seq;       // the futex word
+            std::atomic<uint32_t>   waiters;        // number of readers sleeping on the futex
+            uint32_t                padding;
+            std::atomic<uint64_t>   write_count;    // number of messages written since creation
+        };
+
+        std::string             name;
+        unsigned int            num_records;
+        size_t                  map_size;
+        Header*                 header;
+        Record*                 records;
+        uint64_t                read_count;         // the read cursor of this process
+};
+
+
+///
+/// Sends MIDI messages to a POSIX shared memory ring, from which other processes on the same machine
+/// can read them with a MIDIShmInDriver. Messages are copied into fixed size records (sysex messages
+/// longer than 54 bytes are split over more records) and the readers are woken with a futex, so the
+/// overhead is much lower than going through a virtual MIDI port of the OS.
+///
+/// These drivers are not created by the MIDIManager: you must create them with new and add them to
+/// the manager with MIDIManager::AddOutDriver(), which assigns them a port number.
+/// \note Only one MIDIShmOutDriver for every shared memory name must exist in the system.
+class MIDIShmOutDriver : public MIDIOutDriver {
+    public:
+        /// Creates a MIDIShmOutDriver object.
+        /// \param id The port id (pass MIDIManager::GetNumMIDIOuts(), i.e. the number the port will have
+        /// when added to the manager).
+        /// \param shm_name The name of the shared memory object; it must begin with a '/' (as "/nicmidi_out").
+        /// \param num_records The number of records of the ring (every record holds a short message or
+        /// 54 bytes of a sysex).
+                                MIDIShmOutDriver(int id, const std::string& shm_name,
+                                                 unsigned int num_records = DEFAULT_NUM_RECORDS);
+        /// Closes the shared memory and deletes the object.
+        virtual                 ~MIDIShmOutDriver();
+
+        /// Resets the driver to default conditions (see MIDIOutDriver::Reset()).
+        virtual void            Reset();
+        /// Returns the name of the port, i.e.\ "shm:" followed by the shared memory name.
+        virtual std::string     GetPortName()                   { return "shm:" + ring.GetName(); }
+        /// Returns **true** is the shared memory is open.
+        virtual bool            IsPortOpen() const              { return ring.IsOpen(); }
+        /// Opens the shared memory ring, creating it if needed (see MIDIOutDriver::OpenPort()).
+        virtual void            OpenPort();
+        /// Closes the shared memory ring (see MIDIOutDriver::ClosePort()).
+        virtual void            ClosePort();
+
+        /// The default number of messages in the ring.
+        static const unsigned int DEFAULT_NUM_RECORDS = 1024;
+
+    protected:
+        /// Writes the message into the shared memory ring.
+        virtual void            HardwareMsgOut(const MIDIMessage &msg);
+
+        /// \cond EXCLUDED
+        MIDIShmRing             ring;
+        /// \endcond
+};
+
+
+///
+/// Receives MIDI messages from a POSIX shared memory ring written by a MIDIShmOutDriver in another
+/// process (or in the same one). When the port is open a thread waits for new messages and puts them in
+/// the in queue, stamped with the local time, exactly as the MIDIInDriver does with hardware messages.
+///
+/// These drivers are not created by the MIDIManager: you must create them with new and add them to
+/// the manager with MIDIManager::AddInDriver(), which assigns them a port number. Many processes can
+/// read the same shared memory, each of them gets all the messages.
+class MIDIShmInDriver : public MIDIInDriver {
+    public:
+        /// Creates a MIDIShmInDriver object.
+        /// \param id The port id (pass MIDIManager::GetNumMIDIIns(), i.e. the number the port will have
+        /// when added to the manager).
+        /// \param shm_name The name of the shared memory object; it must begin with a '/' (as "/nicmidi_out").
+        /// \param num_records The number of records of the ring: it must be the same given to the
+        /// MIDIShmOutDriver.
+        /// \param queue_size The size of the in queue (see MIDIInDriver::MIDIInDriver()).
+                                MIDIShmInDriver(int id, const std::string& shm_name,
+                                                unsigned int num_records = MIDIShmOutDriver::DEFAULT_NUM_RECORDS,
+                                                unsigned int queue_size = DEFAULT_QUEUE_SIZE);
+        /// Stops the reading thread, closes the shared memory and deletes the object.
+        virtual                 ~MIDIShmInDriver();
+
+        /// Resets the driver to default conditions (see MIDIInDriver::Reset()).
+        virtual void            Reset();
+        /// Returns the name of the port, i.e.\ "shm:" followed by the shared memory name.
+        virtual std::string     GetPortName()                   { return "shm:" + ring.GetName(); }
+        /// Returns **true** is the shared memory is open.
+        virtual bool            IsPortOpen() const              { return ring.IsOpen(); }
+        /// Opens the shared memory ring and starts the reading thread (see MIDIInDriver::OpenPort()).
+        /// Only messages written after this call are received.
+        virtual void            OpenPort();
+        /// Stops the reading thread and closes the shared memory ring (see MIDIInDriver::ClosePort()).
+        virtual void            ClosePort();
+
+    protected:
+        /// \cond EXCLUDED
+        // The reading thread procedure.
+        static void             ReadProc(MIDIShmInDriver* drv);
+        // Stops the reading thread and closes the ring.
+        void                    StopReading();
+
+        MIDIShmRing             ring;
+        std::thread             read_thread;
+        std::atomic<bool>       reading;
+        /// \endcond
+};
+
+#endif // WIN32
+
+#endif // _JDKMIDI_SHMDRIVER_H
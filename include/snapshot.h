@@ -0,0 +1,145 @@
+/*
+ *   NiCMidi - A C++ Class Library for MIDI
+ *
+ *   Copyright (C) 2021, 2022  Nicola Cassetta
+ *   https://github.com/ncassetta/NiCMidi
+ *
+ *   This file is part of NiCMidi.
+ *
+ *   NiCMidi is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   NiCMidi is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with NiCMidi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/// \file
+/// Contains the definition of the class MIDISnapshot, a columnar copy of the events of a MIDITrack or
+/// MIDIMultiTrack used for fast analysis.
+
+
+#ifndef _JDKMIDI_SNAPSHOT_H
+#define _JDKMIDI_SNAPSHOT_H
+
+#include "track.h"
+#include "multitrack.h"
+
+#include <vector>
+#include <cstdint>
+
+
+///
+/// A read only copy of the events of a MIDITrack or a MIDIMultiTrack, stored by columns: the times, the status
+/// bytes and the two data bytes of all the events are kept in separate arrays. This is intended for the analysis
+/// of large amounts of events (note ranges, velocity distributions, controller usage ...): a scan which examines
+/// only the status bytes reads 1 byte per event instead of a whole MIDITimedMessage, and the scan methods are
+/// simple loops on arrays which the compiler can vectorize.
+///
+/// The snapshot is built by Update(), which copies the events only if the source was edited since the last
+/// call (see MIDITrack::GetEditGeneration()), so you can call it before every analysis without worrying about
+/// its cost. Data end events are not copied; sysex and meta events are copied with their status byte (0xF0 or
+/// 0xFF) and the raw bytes 1 and 2 of the message (for meta events byte 1 is the meta type).
+/// \note The snapshot remembers the addresses of the source tracks only to compare them: a deleted track is
+/// never accessed, and a new track created at the same address is copied again, as its edit generation differs.
+///
+class MIDISnapshot {
+    public:
+        /// Creates an empty snapshot.
+                                MIDISnapshot() {}
+
+        /// Makes the snapshot a copy of the events of _trk_. If the snapshot was already a copy of _trk_ and the
+        /// track was not edited in the meanwhile, does nothing.
+        /// \return **true** if the events were copied, **false** otherwise.
+        bool                    Update(const MIDITrack* trk);
+        /// Makes the snapshot a copy of the events of all the tracks of _multi_. The events of every track are
+        /// copied after those of the previous one (they are not merged in time order), and GetTrack() returns
+        /// the track number of every event. If the snapshot was already a copy of _multi_ and no track was
+        /// edited in the meanwhile, does nothing.
+        /// \return **true** if the events were copied, **false** otherwise.
+        bool                    Update(const MIDIMultiTrack* multi);
+        /// Deletes all the events, freeing the snapshot from its source.
+        void                    Clear();
+
+        /// Returns the number of events.
+        unsigned int            GetNumEvents() const            { return times.size(); }
+        /// Returns the time of the event _i_.
+        MIDIClockTime           GetTime(unsigned int i) const   { return times[i]; }
+        /// Returns the status byte of the event _i_.
+        unsigned char           GetStatus(unsigned int i) const { return statuses[i]; }
+        /// Returns the first data byte of the event _i_.
+        unsigned char           GetByte1(unsigned int i) const  { return bytes1[i]; }
+        /// Returns the second data byte of the event _i_.
+        unsigned char           GetByte2(unsigned int i) const  { return bytes2[i]; }
+        /// Returns the track number of the event _i_ (always 0 if the source was a MIDITrack).
+        unsigned int            GetTrack(unsigned int i) const  { return track_nums[i]; }
+        /// Returns a pointer to the array of the times, which you can use for your own scans.
+        const MIDIClockTime*    GetTimes() const                { return times.data(); }
+        /// Returns a pointer to the array of the status bytes.
+        const unsigned char*    GetStatuses() const             { return statuses.data(); }
+        /// Returns a pointer to the array of the first data bytes.
+        const unsigned char*    GetBytes1() const               { return bytes1.data(); }
+        /// Returns a pointer to the array of the second data bytes.
+        const unsigned char*    GetBytes2() const               { return bytes2.data(); }
+
+        /// Returns the number of events whose status byte, masked with _mask_, is equal to _status_. For
+        /// example Count(NOTE_ON, 0xf0) counts the Note On events of all the channels, Count(NOTE_ON | 9) the
+        /// Note On of channel 10.
+        unsigned int            Count(unsigned char status, unsigned char mask = 0xff) const;
+        /// Fills _ev_nums_ with the numbers of the events whose status byte, masked with _mask_, is equal to
+        /// _status_ (see Count()).
+        /// \return the number of events found.
+        unsigned int            Filter(unsigned char status, unsigned char mask,
+                                       std::vector<unsigned int>& ev_nums) const;
+        /// Fills _ev_nums_ with the numbers of the channel events of the channel _chan_. See \ref NUMBERING.
+        /// \return the number of events found.
+        unsigned int            FilterChannel(int chan, std::vector<unsigned int>& ev_nums) const
+                                    { return Filter(chan & 0x0f, 0x0f, ev_nums, true); }
+        /// Finds the minimum and maximum value of a data byte among the events selected by _status_ and _mask_
+        /// (see Count()). For example GetRange(NOTE_ON, 0xf0, 1, min, max) returns the note range of all
+        /// channels.
+        /// \param status, mask select the events
+        /// \param byte the data byte to examine (1 or 2)
+        /// \param[out] min, max the minimum and maximum value
+        /// \return **false** if no event was selected (_min_ and _max_ are unchanged).
+        bool                    GetRange(unsigned char status, unsigned char mask, int byte,
+                                         unsigned char& min, unsigned char& max) const;
+        /// Adds to _hist_ (an array of 128 elements) the number of times every value of a data byte appears
+        /// among the events selected by _status_ and _mask_ (see Count()). For example
+        /// Histogram(CONTROL_CHANGE, 0xf0, 1, hist) counts the usage of every controller, while
+        /// Histogram(NOTE_ON, 0xf0, 2, hist) gives the distribution of velocities.
+        /// \param status, mask select the events
+        /// \param byte the data byte to examine (1 or 2)
+        /// \param hist the array of the counts: it is not cleared, so you can accumulate several calls
+        void                    Histogram(unsigned char status, unsigned char mask, int byte,
+                                          unsigned int hist[128]) const;
+
+    protected:
+        /// \cond EXCLUDED
+        // Like Filter(), but if chan_only is true selects only channel messages.
+        unsigned int            Filter(unsigned char status, unsigned char mask,
+                                       std::vector<unsigned int>& ev_nums, bool chan_only) const;
+        // Returns true if the sources are the tracks of multi (or trk) with the same edit count.
+        bool                    IsUpToDate(const MIDITrack* const* trks, unsigned int num_trks) const;
+        // Copies the events of the given tracks into the columns.
+        void                    Build(const MIDITrack* const* trks, unsigned int num_trks);
+
+        std::vector<MIDIClockTime>  times;          // The times of the events
+        std::vector<unsigned char>  statuses;       // The status bytes
+        std::vector<unsigned char>  bytes1;         // The first data bytes
+        std::vector<unsigned char>  bytes2;         // The second data bytes
+        std::vector<uint16_t>       track_nums;     // The track numbers
+        std::vector<const MIDITrack*> sources;      // The source tracks ...
+        std::vector<unsigned long long> edit_gens;  // ... and their edit generations when the snapshot was built
+        /// \endcond
+};
+
+
+#endif // _JDKMIDI_SNAPSHOT_H
@@ -34,14 +34,30 @@
 #define JDKSMIDI_SYSEX_H
 
 #include "midi.h"
-#include <vector>
 #include <cstring>          // for memcmp()
+#include <atomic>
+#include <mutex>
+#include <vector>
 
 
 ///
-/// Stores a buffer of MIDI data bytes in a std::vector, plus a byte for the checksum.
+/// Stores a buffer of MIDI data bytes, plus a byte for the checksum.
 /// It is used by the MIDIMessage class for keeping an arbitrary amount of data (tipically the data
 /// attached to a MIDI sysex message, but also the text meta messages and some other type utilizes it).
+/// Most of these are very short (tempo, SMPTE, key and time signature, short texts), so data up to
+/// INLINE_SIZE bytes are stored inside the object itself; a larger buffer is allocated in the heap only
+/// when the data grow over this size.
+///
+/// When a MIDIMessage is copied its MIDISystemExclusive object is not duplicated, but shared between the
+/// copies (the object keeps a count of its owners); it is duplicated only when one of the owners accesses
+/// it for writing through MIDIMessage::EditSysEx(). So copying tracks, multitracks and
+/// sequencer states doesn't copy the data.
+///
+/// The objects are allocated from a pool of blocks, which is enlarged POOL_CHUNK objects at a time and
+/// never shrinks: loading a MIDI file (where nearly every meta event has its object) needs only a few large
+/// allocations, and the objects freed when a song is unloaded are reused by the next one. Every thread
+/// allocates from its own cache of free blocks and exchanges them with the shared pool POOL_BATCH at a time,
+/// so the MIDI input callbacks and the sequencer thread don't contend a lock for every message.
 ///
 class  MIDISystemExclusive {
     public:
@@ -56,7 +72,7 @@ class  MIDISystemExclusive {
         /// \param len the length of the buffer
                                     MIDISystemExclusive(const unsigned char *buf, unsigned int len);
         /// The destructor.
-        virtual	                    ~MIDISystemExclusive() {}
+        virtual	                    ~MIDISystemExclusive();
         /// The assignment operator. It allocates the appropriate memory amount and copies the buffer data, so every
         /// instance has its own buffer.
         MIDISystemExclusive&        operator= (const MIDISystemExclusive& se);
@@ -64,18 +80,18 @@ class  MIDISystemExclusive {
         bool                        operator== (const MIDISystemExclusive &se) const;
 
         /// Resets the buffer to 0 length data and the checksum to 0.
-        void	                    Clear()				        { buffer.clear(); chk_sum = 0;	}
+        void	                    Clear()				        { length = 0; chk_sum = 0;	}
         /// Resets the checksum to 0.
         void	                    ClearChecksum()		        { chk_sum = 0; }
         /// Returns the checksum.
         unsigned char	            GetChecksum() const         { return (unsigned char)(chk_sum & 0x7f); }
         /// Returns the number of data bytes stored in the buffer.
-        int		                    GetLength() const           { return buffer.size(); }
+        int		                    GetLength() const           { return length; }
         /// Returns the i-th byte in the buffer.
         unsigned char	            GetData(int i) const        { return buffer[i]; }
         /// Returns a pointer to the data buffer.
         //unsigned char*          GetBuffer()                 { return buffer; }
-        const unsigned char*        GetBuffer() const           { return buffer.data(); }
+        const unsigned char*        GetBuffer() const           { return buffer; }
         /// Returns **true** if the buffer contains a GM Reset sysex message.
         bool                        IsGMReset() const;
         /// Returns **true** if the buffer contains a GS Reset sysex message.
@@ -83,7 +99,8 @@ class  MIDISystemExclusive {
         /// Returns **true** if the buffer contains a XG Reset sysex message.
         bool                        IsXGReset() const;
         /// Appends a byte to the buffer, without adding it to checksum.
-        void	                    PutSysByte(unsigned char b) { buffer.push_back(b); }
+        void	                    PutSysByte(unsigned char b)
+                                    { if (length == capacity) Grow(length + 1); buffer[length++] = b; }
         /// Appends a byte to the buffer, adding it to checksum.
         void	                    PutByte(unsigned char b)    { PutSysByte(b); chk_sum += b; }
         /// Appends a System exclusive Start byte (0xF0) to the buffer, without affecting the checksum.
@@ -99,17 +116,76 @@ class  MIDISystemExclusive {
         /// Appends the checksum to the buffer.
         void	                    PutChecksum()               { PutByte((unsigned char)(chk_sum & 0x7f)); }
 
+        /// Allocates the memory for an object from the pool.
+        static void*                operator new(size_t size);
+        /// Gives back the memory of an object to the pool.
+        static void                 operator delete(void* p, size_t size);
+        /// Returns the number of objects which can be allocated by the calling thread before the pool is
+        /// enlarged (the free objects in the shared pool plus those cached by the thread).
+        static unsigned int         GetPoolFree();
+
+        /// The max number of bytes stored without heap allocation.
+        static const unsigned int   INLINE_SIZE = 16;
+        /// The number of objects added to the pool when it is enlarged.
+        static const unsigned int   POOL_CHUNK = 256;
+        /// The number of objects moved at a time between the shared pool and the cache of a thread.
+        static const unsigned int   POOL_BATCH = 64;
+
+        /// The bytes of a GM Reset sysex, ready to be sent (this is a compile time constant).
+        static constexpr unsigned char GMReset_data[] = { 0xF0, 0x7E, 0x7F, 0x09, 0x01, 0xF7 };
+        /// The bytes of a GS Reset sysex, ready to be sent (this is a compile time constant).
+        static constexpr unsigned char GSReset_data[] = { 0xF0, 0x41, 0x10, 0x42, 0x12, 0x40, 0x00, 0x7F,
+                                                          0x00, 0x41, 0xF7 };
+        /// The bytes of a XG Reset sysex, ready to be sent (this is a compile time constant).
+        static constexpr unsigned char XGReset_data[] = { 0xF0, 0x43, 0x10, 0x4C, 0x00, 0x00, 0x7E, 0x00, 0xF7 };
+        /// The length of GMReset_data.
+        static const unsigned int   GMReset_len = sizeof(GMReset_data);
+        /// The length of GSReset_data.
+        static const unsigned int   GSReset_len = sizeof(GSReset_data);
+        /// The length of XGReset_data.
+        static const unsigned int   XGReset_len = sizeof(XGReset_data);
+
     protected:
         /// \cond EXCLUDED
-        std::vector<unsigned char>  buffer;
+        friend class MIDIMessage;
+
+        // Enlarges the buffer to at least new_cap bytes, moving it to the heap.
+        void                        Grow(unsigned int new_cap);
+
+        unsigned char*              buffer;         // points to inline_buf or to a heap buffer
+        unsigned int                length;
+        unsigned int                capacity;
         unsigned char               chk_sum;
+        unsigned char               inline_buf[INLINE_SIZE];
+        std::atomic<unsigned int>   ref_count;      // the number of MIDIMessage sharing the object
+
+
+        // the object pool
+        struct PoolBlock {
+            PoolBlock*              next;           // the next free block
+            PoolBlock*              next_batch;     // in the shared pool, the next batch (only in the first block)
+            unsigned int            batch_len;      // in the shared pool, the blocks in the batch (only in the first block)
+        };
+        // the free blocks of a thread: given back to the shared pool when the thread ends
+        struct PoolCache {
+                                    ~PoolCache();
+            PoolBlock*              free;
+            unsigned int            num_free;
+            bool                    closed;         // the thread is ending, use directly the shared pool
+        };
+
+        // Takes a batch of free blocks from the shared pool (enlarging it if empty) into the empty cache
+        static void                 RefillCache(PoolCache& cache);
+        // Adds POOL_CHUNK blocks to the empty shared pool (pool_mutex must be locked)
+        static void                 EnlargePool();
+        // Gives back the first len blocks of the list to the shared pool
+        static void                 ReleaseBatch(PoolBlock* first, unsigned int len);
 
-        static const unsigned char  GMReset_data[];
-        static const unsigned char  GSReset_data[];
-        static const unsigned char  XGReset_data[];
-        static const int            GMReset_len = 6;
-        static const int            GSReset_len = 11;
-        static const int            XGReset_len = 9;
+        static thread_local PoolCache pool_cache;
+        static PoolBlock*           pool_batches;   // the batches of free blocks of the shared pool
+        static unsigned int         pool_num_free;  // the blocks in the shared pool
+        static std::vector<void*>   pool_chunks;
+        static std::mutex           pool_mutex;
         /// \endcond
 };
 
@@ -74,6 +74,8 @@ class MIDITimer {
         static MIDITick*            GetMIDITick()                   { return tick_proc; }
         /// Returns **true** if the timer is running
         static bool                 IsOpen()                        { return (num_open > 0);  }
+        /// Returns **true** if the timer is driven by an external clock (see SetExternalClock()).
+        static bool                 IsExternalClock()               { return external_clock; }
 
         /// Sets the timer resolution to the given value in milliseconds. This method stops the timer
         /// if it is running.
@@ -94,6 +96,14 @@ class MIDITimer {
         /// Stops the timer, joining the background thread procedure, regardless the number of times
         /// Start() was called.
         static void                 HardStop();
+        /// If _on_ is **true** the timer doesn't create its background thread: the callback is instead
+        /// called by an external clock source (for example the JACK process callback, see MIDIJackOutDriver)
+        /// through ExternalTick(). This method stops the timer if it is running.
+        static void                 SetExternalClock(bool on);
+        /// Calls the callback function with the given system time, if the timer is running in
+        /// external clock mode (otherwise it does nothing). This must be called by the external clock
+        /// source at every period.
+        static void                 ExternalTick(tMsecs sys_time);
 
         /// Returns the elapsed time in milliseconds since the start of application. The 0 time is
         /// a chrono::steady_clock::timepoint static variable.
@@ -119,6 +129,7 @@ class MIDITimer {
         static void*                tick_param;         // The callback second parameter set by the user
         static std::thread          bg_thread;          // The background thread
         static std::atomic<int>     num_open;           // The number of times Start() was called without a corresponding Stop()
+        static std::atomic<bool>    external_clock;     // The callback is called by ExternalTick()
         static const timepoint      sys_clock_base;     // The base timepoint for calculating system time
         static timepoint            current;            // Internal use
         /// \endcond
@@ -35,9 +35,14 @@
 #include "midi.h"
 #include "sysex.h"
 #include "msg.h"
+#include "eventbuffer.h"
+#include "transform.h"
+#include "processor.h"
 
 #include <vector>
 #include <string>
+#include <atomic>
+#include <mutex>
 
 /// \addtogroup GLOBALS
 ///@{
@@ -71,7 +76,7 @@ enum
 
 
 ///
-/// Manages a std::vector of MIDITimedMessage objects storing MIDI events, with methods for editing them.
+/// Manages a MIDIEventBuffer of MIDITimedMessage objects storing MIDI events, with methods for editing them.
 /// Events are ordered by time and a MIDITrack has at least the MIDI data end meta-event (EOT)
 /// at its end (it cannot be deleted). Moreover, the Analyze() method examines the events in a track,
 /// classifying it into various types (for example, a master track contains only MIDI meta events, a single
@@ -170,6 +175,20 @@ class  MIDITrack {
         /// (otherwise the function will return 0). It returns TIME_INFINITE if doesn't find the corresponding
         /// Note Off event in the track.
         MIDIClockTime               GetNoteLength (const MIDITimedMessage& msg) const;
+        /// Returns the number of the Note Off event corresponding to the Note On with number _ev_num_ (i.e.\ the
+        /// first following Note Off with the same channel and note), or -1 if _ev_num_ is not a Note On or the
+        /// Note Off is missing. The track keeps an index of these pairs, built when needed and discarded when the
+        /// track is edited, so calling this for every note (for example when drawing a piano roll) costs O(1)
+        /// per note.
+        /// \note The index is built under a lock, so this and GetNoteLength() can be called by many threads at
+        /// the same time (for example the GUI and the sequencer), but not while another thread edits the track.
+        int                         GetNoteOffNumber(int ev_num) const;
+        /// Returns the edit generation of the track, which changes every time the track is edited with one of its
+        /// methods, so comparing it with a previous value tells you if the track was changed (MIDISnapshot uses
+        /// it). The values are taken from a counter shared by all the tracks, so a value is never given to two
+        /// tracks, even if a track is deleted and a new one is created at the same address. Changes made directly
+        /// through GetEventAddress() are not noticed.
+        unsigned long long          GetEditGeneration() const               { return edit_gen; }
         /// Inserts a single event into the track. It could be used for inserting Note On and Note Off events,
         /// but this is better done by InsertNote() which inserts both with a single call. The method handles
         /// automatically the data end message, moving it if needed, so you must not deal with it.
@@ -188,6 +207,9 @@ class  MIDITrack {
         /// + a memory error occurred.
         /// otherwise **true**.
         bool                        InsertEvent(const MIDITimedMessage& msg, tInsMode mode = INSMODE_DEFAULT);
+        /// The same as above, but _msg_ is moved into the track instead of being copied (so its
+        /// MIDISystemExclusive object, if any, is not duplicated).
+        bool                        InsertEvent(MIDITimedMessage&& msg, tInsMode mode = INSMODE_DEFAULT);
         /// Inserts a Note On and a Note Off event into the track. Use this method for inserting note messages as
         /// InsertEvent() doesn't check the correct order of note on/note off. It handles automatically the
         /// EndOfTrack message, moving it if needed, so you must not deal with it. It also determines
@@ -207,6 +229,9 @@ class  MIDITrack {
         /// corresponding Note Off or viceversa).
         bool                        InsertNote(const MIDITimedMessage& msg, MIDIClockTime len,
                                                tInsMode mode = INSMODE_DEFAULT);
+        /// The same as above, but _msg_ is moved into the track instead of being copied.
+        bool                        InsertNote(MIDITimedMessage&& msg, MIDIClockTime len,
+                                               tInsMode mode = INSMODE_DEFAULT);
         /// Deletes an event from the track. Use DeleteNote() for safely deleting both Note On and Note Off. You cannot
         /// delete the data end event.
         /// \param msg a copy of the event to delete.
@@ -224,10 +249,24 @@ class  MIDITrack {
         /// check temporal order and track consistency. You could use it if you would manually copy tracks
         /// (MultiTrack::AssignEventsToTracks() does it).
         void                        PushEvent(const MIDITimedMessage& msg);
+        /// The same as above, but _msg_ is moved into the track instead of being copied.
+        void                        PushEvent(MIDITimedMessage&& msg);
+        /// Prepares the track for a bulk insertion of events: reserves memory for _num_events_ more events,
+        /// which you can then add with PushEvent() in any order, calling EndBulkInsert() at the end. This is
+        /// much faster than calling InsertEvent() for every event, as the events are sorted only once (the
+        /// file loader and MIDIMultiTrack::AssignEventsToTracks() use it).
+        /// \warning The track is not ordered until you call EndBulkInsert(), so you must not call other
+        /// methods in the meanwhile.
+        void                        BeginBulkInsert(unsigned int num_events = 0);
+        /// Sorts the events pushed after BeginBulkInsert() with a single stable sort, merging them with the
+        /// older ones, and adjusts the EOT time. Events with the same time are ordered as InsertEvent() does in
+        /// INSMODE_INSERT mode (see MIDITimedMessage::CompareEventsForInsert()), while equal events keep the
+        /// order in which they were pushed (and follow the older ones).
+        void                        EndBulkInsert();
         /// Shifts forward by a _length_ time the track events from _start_ onwards. If _src_ == 0 it leaves the newly
         /// created interval empty, otherwise copies the contents of _src_ into it. The events in the time interval
         /// 0 ...       _length_ in _src_ are copied into the _start_ ... _start_ + _length_ times in the actual track.
-        /// If the _src_ end time is greater than _length_ the copy process is truncated.
+        /// If the _src_ end time is greater than _length_ the copy process is truncated. _src_ must be another track.
         /// \warning This is still experimental, not tested enough
         void                        InsertInterval(MIDIClockTime start, MIDIClockTime length, const MIDITrack* src = 0);
                                                     // if src == 0 only shift events of length clocks
@@ -243,15 +282,25 @@ class  MIDITrack {
         void                        ClearInterval(MIDIClockTime start, MIDIClockTime end);
         /// Replaces events from _start_ to _end_ with those in _src_. The events in the time interval
         /// 0 ... _end_ - _start_ in _src_ are copied into the _start_ ... _end_ times in the actual track.
-        /// If the _src_ end time is greater than _end_ - _start_ the copy process is truncated.
+        /// If the _src_ end time is greater than _end_ - _start_ the copy process is truncated. _src_ must be
+        /// another track.
         /// \warning This is still experimental, not tested enough
         void                        ReplaceInterval(MIDIClockTime start, MIDIClockTime end, const MIDITrack* src);
         /// Cuts note and pedal events (searching to the time _from_) at the time _to_. All sounding notes and
         /// held pedals are truncated (the corresponding off events after the time _to_ are deleted) and the pitch
         /// bend is reset. Events at time _to_ are **not** truncated. This function is intended for "slicing"
-        /// a track in cut, copy and paste editing.
-        // TODO: restored old version: test this (involves even interval methods)
+        /// a track in cut, copy and paste editing. Notes and pedals pressed again at time _to_ keep their off
+        /// events. The track is scanned only once, and all the closing events are inserted in a single block.
         void                        CloseOpenEvents(MIDIClockTime from, MIDIClockTime to);
+        /// Applies the operations of _tr_ to all the events of the track in a single pass (see MIDITransform). If
+        /// the times or the channels of the events are changed, they are sorted again with a single stable sort
+        /// at the end, instead of moving every event to its new place.
+        void                        Transform(const MIDITransform& tr);
+        /// Deletes the redundant events of the track, as the processor _comp_ would drop them in real time (see
+        /// MIDIProcessorCompactor::Check()), and the notes with zero length (if the processor allows it). The
+        /// processor starts with no remembered values, and all deletions are done in a single pass at the end.
+        /// \return the number of deleted events.
+        unsigned int                Compact(MIDIProcessorCompactor& comp);
 
         /// Finds an event in the track matching a given event.
         /// \param[in] msg the event to look for
@@ -308,21 +357,53 @@ class  MIDITrack {
 
 
     protected:
-        /// Analyses the events in the track upgrading its status attribute. This is called automatically by GetType()
-        /// when needed (i.e. the track was edited by one of the above methods and the status is no more valid), so has
-        /// no utility for the user.
+        /// Upgrades the status attribute of the track from the counters of the event kinds, which are kept updated
+        /// when events are inserted or deleted (so this doesn't examine the events). This is called automatically
+        /// by GetType() when needed (i.e. the track was edited by one of the above methods and the status is no
+        /// more valid), so has no utility for the user.
         void                        Analyze();
 
         /// \cond EXCLUDED
-        std::vector<MIDITimedMessage>
-                                    events;     // The buffer of events
+        // Marks the track as edited, so its status and the note index must be recalculated.
+        void                        SetDirty()          { status |= STATUS_DIRTY; note_offs_valid = false;
+                                                          edit_gen = NewEditGeneration(); }
+        // Returns a new edit generation (see GetEditGeneration()), never returned before.
+        static unsigned long long   NewEditGeneration()
+                                        { return last_edit_gen.fetch_add(1, std::memory_order_relaxed) + 1; }
+        // Returns true if the index of the Note Off (see GetNoteOffNumber()) is up to date.
+        bool                        IsNoteIndexValid() const
+                                        { return note_offs_valid.load(std::memory_order_acquire) &&
+                                                 note_offs.size() == events.size(); }
+        // Erases the Note On with number ev_num and its Note Off.
+        void                        EraseNote(int ev_num);
+        // Copies the events of src in the time interval 0 ... length - 1 into the interval start ... start + length - 1,
+        // which must be empty (apart from events at start time). Used by InsertInterval() and ReplaceInterval().
+        void                        CopyInterval(MIDIClockTime start, MIDIClockTime length, const MIDITrack* src);
+        // Updates the counters of the event kinds when msg is added (n = 1) or removed (n = -1).
+        void                        CountEvent(const MIDITimedMessage& msg, int n);
+        // Sets all the counters of the event kinds to 0.
+        void                        ResetCounters();
+
+        MIDIEventBuffer             events;     // The buffer of events
         int                         status;     // A bitfield used to determine the track type
         signed char                 rec_chan;   // The channel for recordng, or -1 for all channels
         int                         time_shift; // The time shift in MIDI ticks
         unsigned int                in_port;    // The in port id for recording midi events
         unsigned int                out_port;   // The out port id for playing midi events
+        unsigned int                bulk_start; // The first event pushed after BeginBulkInsert()
+        mutable std::vector<int>    note_offs;  // For every Note On the number of its Note Off (see
+                                                // GetNoteOffNumber()) ...
+        mutable std::atomic<bool>   note_offs_valid;    // ... false if it must be rebuilt
+        mutable std::mutex          note_offs_mutex;    // Locks the rebuilding of note_offs
+        unsigned int                chan_events[16];// The number of channel events for every channel
+        unsigned int                main_metas; // The number of main meta events (DATA_END excluded)
+        unsigned int                text_metas; // The number of text meta events
+        unsigned int                sysexes;    // The number of common sysex events
+        unsigned int                reset_sysexes; // The number of GM, GS and XG reset sysex events
+        unsigned long long          edit_gen;   // Changed by every edit (see GetEditGeneration())
 
         static tInsMode             ins_mode;   // See SetInsertMode()
+        static std::atomic<unsigned long long> last_edit_gen;  // The last edit generation given to a track
         /// \endcond
 };
 
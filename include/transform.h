@@ -0,0 +1,128 @@
+/*
+ *   NiCMidi - A C++ Class Library for MIDI
+ *
+ *   Copyright (C) 2021, 2022  Nicola Cassetta
+ *   https://github.com/ncassetta/NiCMidi
+ *
+ *   This file is part of NiCMidi.
+ *
+ *   NiCMidi is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   NiCMidi is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with NiCMidi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/// \file
+/// Contains the definition of the class MIDITransform, a set of editing operations applied to all the events
+/// of a MIDITrack or MIDIMultiTrack.
+
+
+#ifndef _JDKMIDI_TRANSFORM_H
+#define _JDKMIDI_TRANSFORM_H
+
+#include "msg.h"
+
+
+///
+/// Describes a set of operations to be applied to every event of a MIDITrack (see MIDITrack::Transform()) or
+/// MIDIMultiTrack (see MIDIMultiTrack::Transform()): transposing, velocity curve, channel remapping, time
+/// stretching and quantizing. You set the operations you want with the Set...() methods (the others are left
+/// unchanged) and then apply all of them in a single pass on the events. Unlike a MIDIProcessor, which
+/// changes the messages while they are played, this changes the events stored in the track, and it has no
+/// virtual methods, so the compiler can inline the processing of every event.
+///
+/// The operations are applied in this order: channel remapping, transposing (with the original channel),
+/// velocity curve, time stretching and quantizing.
+///
+class MIDITransform {
+    public:
+        /// Creates an object which leaves the events unchanged.
+                                MIDITransform()                         { Reset(); }
+        /// Resets the object to its initial state (no operation).
+        void                    Reset();
+
+        /// Returns the transposing amount (in semitones) for the given channel. See \ref NUMBERING.
+        int                     GetChannelTranspose(int chan) const     { return trans_amount[chan]; }
+        /// Returns the destination channel of the channel _chan_. See \ref NUMBERING.
+        int                     GetChannelMap(int chan) const           { return chan_map[chan]; }
+        /// Returns the new value of the velocity _vel_.
+        unsigned char           GetVelocity(unsigned char vel) const    { return vel_curve[vel & 0x7f]; }
+        /// Returns the time stretch ratio (1.0 if times are not stretched).
+        double                  GetTimeStretch() const                  { return stretch; }
+        /// Returns the quantize grid in MIDI ticks (0 if notes are not quantized).
+        MIDIClockTime           GetQuantize() const                     { return grid; }
+
+        /// Sets the transposing amount (in semitones) of note and poly pressure messages of the channel _chan_.
+        /// Notes which would go out of the MIDI range are left unchanged. See \ref NUMBERING.
+        void                    SetChannelTranspose(int chan, int trans)    { trans_amount[chan] = trans; }
+        /// Sets the same transposing amount (in semitones) for all the channels.
+        void                    SetAllTranspose(int trans);
+        /// Sets the destination channel of the messages of the channel _src_chan_. See \ref NUMBERING.
+        void                    SetChannelMap(int src_chan, int dest_chan)  { chan_map[src_chan] = dest_chan; }
+        /// Sends the messages of all the channels to the channel _dest_chan_.
+        void                    SetAllChannels(int dest_chan);
+        /// Sets the velocity curve: the Note On velocities _v_ will become _curve[v]_. A value of 0 in _curve_
+        /// is changed to 1, because a Note On with 0 velocity would be a Note Off.
+        void                    SetVelocityCurve(const unsigned char curve[128]);
+        /// Sets a linear velocity curve: the velocity _v_ becomes _v_ * _percent_ / 100 + _offset_, limited
+        /// to the range 1 ... 127.
+        void                    SetVelocityScale(int percent, int offset = 0);
+        /// Multiplies the times of all events (and the track end) by _ratio_ (for example 2.0 doubles the
+        /// length of the track).
+        void                    SetTimeStretch(double ratio)            { stretch = ratio; }
+        /// Moves every Note On to the nearest multiple of _ticks_, and its Note Off by the same amount, so that
+        /// the note length is preserved. Other events are not moved. 0 disables quantizing.
+        void                    SetQuantize(MIDIClockTime ticks)        { grid = ticks; }
+
+        /// Returns **true** if the transform changes the event times.
+        bool                    ChangesTimes() const                    { return stretch != 1.0 || grid != 0; }
+        /// Returns **true** if the transform changes the channel of some messages.
+        bool                    ChangesChannels() const;
+
+        /// Applies the channel map, the transposing and the velocity curve to _msg_ (but not the time
+        /// operations, which need the whole track).
+        void                    ProcessMessage(MIDITimedMessage& msg) const;
+        /// Returns the stretched time _t_.
+        MIDIClockTime           StretchTime(MIDIClockTime t) const
+                                    { return stretch == 1.0 ? t : (MIDIClockTime)(t * stretch + 0.5); }
+        /// Returns the nearest multiple of the quantize grid to _t_.
+        MIDIClockTime           QuantizeTime(MIDIClockTime t) const
+                                    { return grid == 0 ? t : (t + grid / 2) / grid * grid; }
+
+    protected:
+        /// \cond EXCLUDED
+        int                     trans_amount[16];   // The transposing amount for every channel
+        signed char             chan_map[16];       // The destination channel for every channel
+        unsigned char           vel_curve[128];     // The new value of every velocity
+        double                  stretch;            // The time stretch ratio
+        MIDIClockTime           grid;               // The quantize grid
+        /// \endcond
+};
+
+
+inline void MIDITransform::ProcessMessage(MIDITimedMessage& msg) const {
+    if (!msg.IsChannelMsg())
+        return;
+    int chan = msg.GetChannel();
+    if (msg.IsNote() || msg.IsPolyPressure()) {
+        int note = msg.GetNote() + trans_amount[chan];
+        if (note >= 0 && note <= 127)
+            msg.SetNote(note);
+        if (msg.IsNoteOn())
+            msg.SetVelocity(vel_curve[msg.GetVelocity()]);
+    }
+    if (chan_map[chan] != chan)
+        msg.SetChannel(chan_map[chan]);
+}
+
+
+#endif // _JDKMIDI_TRANSFORM_H
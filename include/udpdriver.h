@@ -0,0 +1,219 @@
+/*
+ *   NiCMidi - A C++ Class Library for MIDI
+ *
+ *   Copyright (C) 2021, 2022  Nicola Cassetta
+ *   https://github.com/ncassetta/NiCMidi
+ *
+ *   This file is part of NiCMidi.
+ *
+ *   NiCMidi is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   NiCMidi is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with NiCMidi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/// \file
+/// Contains the definition of the classes MIDIUdpOutDriver and MIDIUdpInDriver, used to send MIDI
+/// messages to other computers over an UDP network.
+
+
+#ifndef _JDKMIDI_UDPDRIVER_H
+#define _JDKMIDI_UDPDRIVER_H
+
+#include "driver.h"
+
+#ifndef WIN32
+
+#include <atomic>
+#include <thread>
+#include <string>
+#include <vector>
+#include <deque>
+#include <netinet/in.h>
+
+
+///
+/// Sends MIDI messages over the network to a MIDIUdpInDriver, with a protocol similar to RTP-MIDI.
+/// Messages are not sent one by one: they are packed into a datagram, with their time offset from the
+/// packet timestamp, and the datagram is sent at the end of every timer tick (see FlushOutput()) or when
+/// it is full. Every datagram carries also a journal, i.e.\ a copy of the messages of the previous
+/// datagrams, so that the receiver can recover the messages of lost datagrams.
+/// \note The protocol is a simplified version of RTP-MIDI (RFC 6295): it is not compatible with
+/// AppleMIDI sessions, it is only intended to connect NiCMidi programs. Sysex messages longer than
+/// a datagram can hold are split into segments (as in RTP-MIDI, the first ends with 0xF0, the middle ones
+/// begin with 0xF7 and end with 0xF0, the last begins and ends with 0xF7) which are joined by the receiver.
+///
+/// These drivers are not created by the MIDIManager: you must create them with new and add them to
+/// the manager with MIDIManager::AddOutDriver(), which assigns them a port number.
+class MIDIUdpOutDriver : public MIDIOutDriver {
+    public:
+        /// Creates a MIDIUdpOutDriver object.
+        /// \param id The port id (pass MIDIManager::GetNumMIDIOuts(), i.e. the number the port will have
+        /// when added to the manager).
+        /// \param host The IPv4 address of the receiver (as "192.168.1.10"); the default is the loopback address.
+        /// \param udp_port The UDP port of the receiver.
+        /// \param journal_depth The number of previous datagrams copied in the journal (0 disables it). Values
+        /// greater than MAX_JOURNAL_DEPTH are clamped, as the datagram could exceed the max UDP size.
+                                MIDIUdpOutDriver(int id, const std::string& host = "127.0.0.1",
+                                                 unsigned short udp_port = DEFAULT_UDP_PORT,
+                                                 unsigned int journal_depth = DEFAULT_JOURNAL_DEPTH);
+        /// Closes the socket and deletes the object.
+        virtual                 ~MIDIUdpOutDriver();
+
+        /// Resets the driver to default conditions (see MIDIOutDriver::Reset()).
+        virtual void            Reset();
+        /// Returns the name of the port, i.e.\ "udp:" followed by host and port (as "udp:127.0.0.1:5004").
+        virtual std::string     GetPortName();
+        /// Returns **true** is the socket is open.
+        virtual bool            IsPortOpen() const              { return sock != -1; }
+        /// Returns the number of datagrams sent since the port was open.
+        unsigned long           GetNumPackets() const           { return num_packets; }
+        /// Returns the number of messages sent since the port was open.
+        unsigned long           GetNumMessages() const          { return num_messages; }
+        /// Returns **true** if auto flush is on (see SetAutoFlush()).
+        bool                    GetAutoFlush() const            { return auto_flush; }
+
+        /// If auto flush is on (the default) and the MIDITimer is not running every message is sent
+        /// immediately, because there are no timer ticks which could send it. Turn it off if you want to
+        /// pack messages anyway and send them by calling FlushOutput() by yourself.
+        void                    SetAutoFlush(bool on)           { auto_flush = on; }
+        /// Opens the UDP socket (see MIDIOutDriver::OpenPort()).
+        virtual void            OpenPort();
+        /// Sends the buffered messages and closes the UDP socket (see MIDIOutDriver::ClosePort()).
+        virtual void            ClosePort();
+        /// Sends the buffered messages in a datagram.
+        virtual void            FlushOutput();
+
+        /// The default UDP port (the same of RTP-MIDI).
+        static const unsigned short DEFAULT_UDP_PORT = 5004;
+        /// The default number of previous datagrams in the journal.
+        static const unsigned int DEFAULT_JOURNAL_DEPTH = 2;
+        /// The max length (in bytes) of the messages packed in a datagram.
+        static const unsigned int MAX_CMD_LENGTH = 400;
+        /// The max number of previous datagrams in the journal, so that a datagram (a 4 bytes header and
+        /// journal_depth + 1 sections of 8 + MAX_CMD_LENGTH bytes) never exceeds 65507 bytes, the max UDP size.
+        static const unsigned int MAX_JOURNAL_DEPTH = (65507 - 4) / (MAX_CMD_LENGTH + 8) - 1;
+
+    protected:
+        /// Appends the message to the datagram, sending it if it is full (or if the timer is not running,
+        /// see SetAutoFlush()).
+        virtual void            HardwareMsgOut(const MIDIMessage &msg);
+
+        /// \cond EXCLUDED
+        // Appends the bytes of a message (or of a sysex segment) to the datagram.
+        void                    PutCmd(const unsigned char* bytes, unsigned int len);
+        // A command section: the packed messages of a datagram, with its sequence number and timestamp.
+        struct CmdSection {
+            uint16_t                    seq;
+            uint32_t                    timestamp;
+            std::vector<unsigned char>  cmd;
+        };
+
+        std::string             host;
+        unsigned short          udp_port;
+        unsigned int            journal_depth;
+        int                     sock;
+        sockaddr_in             dest;
+        bool                    auto_flush;
+
+        CmdSection              current;        // the datagram we are filling
+        std::deque<CmdSection>  journal;        // the last datagrams sent (the newest first)
+        uint16_t                next_seq;
+        unsigned long           num_packets;
+        unsigned long           num_messages;
+        /// \endcond
+
+    private:
+        std::vector<unsigned char>  packet;
+        std::vector<unsigned char>  segment;
+};
+
+
+///
+/// Receives MIDI messages sent over the network by a MIDIUdpOutDriver. When the port is open a thread waits
+/// for datagrams, unpacks them and puts the messages in the in queue (stamped with the local time), exactly
+/// as the MIDIInDriver does with hardware messages. If some datagrams are lost their messages are recovered,
+/// when possible, from the journal of the next one. The driver keeps some statistics which you can use to
+/// test the connection; the latency is significant only if sender and receiver are in the same process,
+/// because they must share the MIDITimer time.
+///
+/// These drivers are not created by the MIDIManager: you must create them with new and add them to
+/// the manager with MIDIManager::AddInDriver(), which assigns them a port number.
+class MIDIUdpInDriver : public MIDIInDriver {
+    public:
+        /// Creates a MIDIUdpInDriver object.
+        /// \param id The port id (pass MIDIManager::GetNumMIDIIns(), i.e. the number the port will have
+        /// when added to the manager).
+        /// \param udp_port The UDP port on which the driver listens.
+        /// \param queue_size The size of the in queue (see MIDIInDriver::MIDIInDriver()).
+                                MIDIUdpInDriver(int id, unsigned short udp_port = MIDIUdpOutDriver::DEFAULT_UDP_PORT,
+                                                unsigned int queue_size = DEFAULT_QUEUE_SIZE);
+        /// Stops the receiving thread, closes the socket and deletes the object.
+        virtual                 ~MIDIUdpInDriver();
+
+        /// Resets the driver to default conditions (see MIDIInDriver::Reset()) and the statistics.
+        virtual void            Reset();
+        /// Returns the name of the port, i.e.\ "udp:" followed by the UDP port number.
+        virtual std::string     GetPortName();
+        /// Returns **true** is the socket is open.
+        virtual bool            IsPortOpen() const              { return sock != -1; }
+        /// Returns the number of datagrams received.
+        unsigned long           GetNumPackets() const           { return num_packets; }
+        /// Returns the number of messages received (including the recovered ones).
+        unsigned long           GetNumMessages() const          { return num_messages; }
+        /// Returns the number of lost datagrams.
+        unsigned long           GetNumLost() const              { return num_lost; }
+        /// Returns the number of lost datagrams recovered from the journal.
+        unsigned long           GetNumRecovered() const         { return num_recovered; }
+        /// Returns the average latency (in msecs) of the received messages (see the class description).
+        double                  GetAverageLatency() const
+                                    { return num_messages ? (double)latency_sum / num_messages : 0.0; }
+        /// Returns the max latency (in msecs) of the received messages (see the class description).
+        unsigned long           GetMaxLatency() const           { return max_latency; }
+
+        /// Opens the socket and starts the receiving thread (see MIDIInDriver::OpenPort()).
+        virtual void            OpenPort();
+        /// Stops the receiving thread and closes the socket (see MIDIInDriver::ClosePort()).
+        virtual void            ClosePort();
+
+    protected:
+        /// \cond EXCLUDED
+        // The receiving thread procedure.
+        static void             ReceiveProc(MIDIUdpInDriver* drv);
+        // Stops the receiving thread and closes the socket.
+        void                    StopReceiving();
+        // Unpacks a command section, putting its messages into the queue.
+        void                    ParseCmd(const unsigned char* cmd, unsigned int len, uint32_t timestamp);
+        // Puts a message into the queue.
+        void                    PutMessage(const unsigned char* bytes, unsigned int len, uint32_t send_time);
+
+        unsigned short          udp_port;
+        int                     sock;
+        std::thread             recv_thread;
+        std::atomic<bool>       receiving;
+
+        bool                    first_packet;
+        uint16_t                expected_seq;
+        bool                    in_sysex;       // we are joining the segments of a sysex
+        std::vector<unsigned char> sysex_buf;
+        std::atomic<unsigned long> num_packets;
+        std::atomic<unsigned long> num_messages;
+        std::atomic<unsigned long> num_lost;
+        std::atomic<unsigned long> num_recovered;
+        std::atomic<unsigned long> latency_sum;
+        std::atomic<unsigned long> max_latency;
+        /// \endcond
+};
+
+#endif // WIN32
+
+#endif // _JDKMIDI_UDPDRIVER_H
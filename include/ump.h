@@ -0,0 +1,100 @@
+/*
+ *   NiCMidi - A C++ Class Library for MIDI
+ *
+ *   Copyright (C) 2021, 2022  Nicola Cassetta
+ *   https://github.com/ncassetta/NiCMidi
+ *
+ *   This file is part of NiCMidi.
+ *
+ *   NiCMidi is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   NiCMidi is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with NiCMidi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/// \file
+/// Contains the definition of the struct MIDIUmp, a Universal MIDI Packet used as compact internal
+/// representation of MIDI messages.
+
+
+#ifndef _JDKMIDI_UMP_H
+#define _JDKMIDI_UMP_H
+
+#include "msg.h"
+
+#include <cstdint>
+
+
+///
+/// A 64 bit Universal MIDI Packet (UMP), as defined by the MIDI 2.0 specifications. The library uses it as
+/// a compact internal representation of MIDI 1.0 messages: it is trivially copyable (it has no pointers), so
+/// queues of packets can be moved around without allocating memory. MIDIMessage objects are converted to
+/// packets only when they enter a queue and back when they leave it.
+///
+/// Only three message types are used:
+/// - system messages (type 0x1, 32 bits): status, byte 1 and byte 2 of the message.
+/// - MIDI 1.0 channel messages (type 0x2, 32 bits): the same.
+/// - data messages (type 0x3, 64 bits): a sysex is split into packets which carry up to 6 bytes each (without
+///   the 0xF0 and 0xF7 bytes).
+///
+/// Meta events and other non MIDI messages (as the NoOp) cannot be converted.
+struct MIDIUmp {
+        /// The message types (the upper 4 bits of the first word).
+        enum {
+            UMP_UTILITY         = 0x0,  ///< Utility messages (NoOp, timestamps): not used
+            UMP_SYSTEM          = 0x1,  ///< System common and real time messages
+            UMP_MIDI1_CHANNEL   = 0x2,  ///< MIDI 1.0 channel voice messages
+            UMP_DATA64          = 0x3   ///< 7 bit data (sysex) messages
+        };
+        /// The status of a data packet, i.e.\ its position in the sysex.
+        enum {
+            PACKET_COMPLETE     = 0x0,  ///< The whole sysex is in this packet
+            PACKET_START        = 0x1,  ///< The first packet of a sysex
+            PACKET_CONTINUE     = 0x2,  ///< A middle packet of a sysex
+            PACKET_END          = 0x3   ///< The last packet of a sysex
+        };
+        /// The max number of sysex data bytes in a packet.
+        static const unsigned int SYSEX_BYTES = 6;
+
+        /// Returns the message type (see the enum).
+        unsigned char           GetMessageType() const      { return (unsigned char)(words[0] >> 28); }
+        /// Returns the UMP group (0 ... 15).
+        unsigned char           GetGroup() const            { return (words[0] >> 24) & 0x0f; }
+        /// Returns the MIDI status byte of a system or channel packet.
+        unsigned char           GetStatus() const           { return (words[0] >> 16) & 0xff; }
+        /// Returns the status of a data packet (see the enum).
+        unsigned char           GetSysExStatus() const      { return (words[0] >> 20) & 0x0f; }
+        /// Returns the number of sysex bytes in a data packet.
+        unsigned char           GetSysExLength() const      { return (words[0] >> 16) & 0x0f; }
+        /// Returns the sysex byte _i_ (0 ... 5) of a data packet.
+        unsigned char           GetSysExByte(unsigned int i) const
+                                    { return i < 2 ? (words[0] >> (8 - 8 * i)) & 0xff :
+                                                     (words[1] >> (24 - 8 * (i - 2))) & 0xff; }
+
+        /// Returns the number of packets needed for converting _msg_, 0 if it cannot be converted.
+        static unsigned int     GetNumPackets(const MIDIMessage& msg);
+        /// Converts _msg_ into packets, returning the packet _n_ (0 ... GetNumPackets(msg) - 1).
+        /// \param msg the message
+        /// \param n the index of the packet (only sysex messages need more than one)
+        /// \param group the UMP group of the packet
+        static MIDIUmp          FromMessage(const MIDIMessage& msg, unsigned int n = 0, unsigned char group = 0);
+        /// Converts the packet back into _msg_. A packet starting a message (i.e.\ a system or channel packet,
+        /// or the first packet of a sysex) overwrites _msg_, while the following packets of a sysex append
+        /// their data to it.
+        /// \return **true** if _msg_ is complete, **false** if more packets are needed.
+        bool                    ToMessage(MIDIMessage& msg) const;
+
+        uint32_t                words[2];   ///< The packet words (the second is unused in 32 bit packets)
+};
+
+
+#endif // _JDKMIDI_UMP_H
@@ -270,17 +270,17 @@ int AdvancedSequencer::GetKeySigMode() const {
 }
 
 
-std::string AdvancedSequencer::GetCurrentMarker() const {
+const std::string& AdvancedSequencer::GetCurrentMarker() const {
     if (!file_loaded)
-        return "";
-    return state.marker_text;
+        return MIDIMultiTrack::empty_text;
+    return *state.marker_text;
 }
 
 
-std::string AdvancedSequencer::GetTrackName (unsigned int trk_num) const {
+const std::string& AdvancedSequencer::GetTrackName (unsigned int trk_num) const {
     if (!file_loaded)
-        return "";
-    return GetTrackState(trk_num)->track_name;
+        return MIDIMultiTrack::empty_text;
+    return *GetTrackState(trk_num)->track_name;
 }
 
 
@@ -748,16 +748,17 @@ void AdvancedSequencer::CatchEventsBefore() {
     for (unsigned int i = 0; i < GetNumTracks(); i++) {
         trk = GetTrack(i);
         if (!(trk->HasSysex())) continue;
-        msg.SetTime(0);
         port = GetTrackOutPort(i);
-        for (unsigned int j = 0; j < trk->GetNumEvents() && msg.GetTime() <= GetCurrentMIDIClockTime(); j++) {
-            msg = trk->GetEvent(j);
-            if (msg.IsSysEx() &&
-                !(msg.GetSysEx()->IsGMReset() || msg.GetSysEx()->IsGSReset() || msg.GetSysEx()->IsXGReset())) {
-
+        for (unsigned int j = 0; j < trk->GetNumEvents(); j++) {
+            const MIDITimedMessage& ev = trk->GetEvent(j);
+            if ((ev.Classify() & MSG_SYSEX) &&
+                !(ev.GetSysEx()->IsGMReset() || ev.GetSysEx()->IsGSReset() || ev.GetSysEx()->IsXGReset())) {
+                msg = ev;
                 OutputMessage(msg, port);
                 events_sent++;
             }
+            if (ev.GetTime() > GetCurrentMIDIClockTime())
+                break;
         }
     }
 
@@ -796,13 +797,15 @@ void AdvancedSequencer::CatchEventsBefore() {
         trk = GetTrack(i);
         if (trk->GetType() == MIDITrack::TYPE_MIXED_CHAN) {
             port = GetTrackOutPort(i);
-            msg.SetTime(0);
-            for (unsigned int j = 0; j < trk->GetNumEvents() && msg.GetTime() <= GetCurrentMIDIClockTime(); j++) {
-                msg = trk->GetEvent(j);
-                if (msg.IsProgramChange() || msg.IsControlChange() || msg.IsPitchBend()) {
+            for (unsigned int j = 0; j < trk->GetNumEvents(); j++) {
+                const MIDITimedMessage& ev = trk->GetEvent(j);
+                if (ev.Classify() & (MSG_PROGRAM_CHANGE | MSG_CONTROL_CHANGE | MSG_PITCH_BEND)) {
+                    msg = ev;
                     OutputMessage(msg, port);
                     events_sent++;
                 }
+                if (ev.GetTime() > GetCurrentMIDIClockTime())
+                    break;
             }
         }
     }
@@ -826,15 +829,16 @@ void AdvancedSequencer::CatchEventsBefore(int trk_num) {
 
     //first send sysex (but not reset ones)
     if (trk->HasSysex()) {
-        msg.SetTime(0);
-        for (unsigned int i = 0; i < trk->GetNumEvents() && msg.GetTime() <= GetCurrentMIDIClockTime(); i++) {
-            msg = trk->GetEvent(i);
-            if (msg.IsSysEx() &&
-                !(msg.GetSysEx()->IsGMReset() || msg.GetSysEx()->IsGSReset() || msg.GetSysEx()->IsXGReset())) {
-
+        for (unsigned int i = 0; i < trk->GetNumEvents(); i++) {
+            const MIDITimedMessage& ev = trk->GetEvent(i);
+            if ((ev.Classify() & MSG_SYSEX) &&
+                !(ev.GetSysEx()->IsGMReset() || ev.GetSysEx()->IsGSReset() || ev.GetSysEx()->IsXGReset())) {
+                msg = ev;
                 OutputMessage(msg, port);
                 events_sent++;
             }
+            if (ev.GetTime() > GetCurrentMIDIClockTime())
+                break;
         }
     }
 
@@ -866,13 +870,15 @@ void AdvancedSequencer::CatchEventsBefore(int trk_num) {
         }
         // if the track has mixed channels send all previous messages
         else if (trk->GetType() == MIDITrack::TYPE_MIXED_CHAN) {
-            msg.SetTime(0);
-            for (unsigned int i = 0; i < trk->GetNumEvents() && msg.GetTime() <= GetCurrentMIDIClockTime(); i++) {
-                msg = trk->GetEvent(i);
-                if (msg.IsProgramChange() || msg.IsControlChange() || msg.IsPitchBend()) {
+            for (unsigned int i = 0; i < trk->GetNumEvents(); i++) {
+                const MIDITimedMessage& ev = trk->GetEvent(i);
+                if (ev.Classify() & (MSG_PROGRAM_CHANGE | MSG_CONTROL_CHANGE | MSG_PITCH_BEND)) {
+                    msg = ev;
                     OutputMessage(msg, port);
                     events_sent++;
                 }
+                if (ev.GetTime() > GetCurrentMIDIClockTime())
+                    break;
             }
         }
     }
@@ -0,0 +1,241 @@
+/*
+ *   NiCMidi - A C++ Class Library for MIDI
+ *
+ *   Copyright (C) 2021, 2022  Nicola Cassetta
+ *   https://github.com/ncassetta/NiCMidi
+ *
+ *   This file is part of NiCMidi.
+ *
+ *   NiCMidi is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   NiCMidi is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with NiCMidi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "../include/compressedtrack.h"
+
+
+/////////////////////////////////////////////////
+//          class MIDICompressedTrack          //
+/////////////////////////////////////////////////
+
+
+void MIDICompressedTrack::Compress(const MIDITrack* trk) {
+    Clear();
+    MIDIClockTime prev_time = 0;
+    unsigned char running_status = 0;
+    for (unsigned int i = 0; i < trk->GetNumEvents(); i++) {
+        if (i % SEEK_INTERVAL == 0) {
+            SeekPoint sp = { prev_time, (uint32_t)data.size(), i, running_status };
+            seek_points.push_back(sp);
+        }
+        const MIDITimedMessage& msg = trk->GetEvent(i);
+        Encode(msg, prev_time, running_status);
+        prev_time = msg.GetTime();
+    }
+    num_events = trk->GetNumEvents();
+    end_time = trk->GetEndTime();
+    data.shrink_to_fit();                       // the object is immutable, so free the unused memory
+    seek_points.shrink_to_fit();
+}
+
+
+void MIDICompressedTrack::Decompress(MIDITrack* trk) const {
+    trk->Clear();
+    trk->BeginBulkInsert(num_events);
+    MIDITimedMessage msg;
+    uint32_t offset = 0;
+    MIDIClockTime prev_time = 0;
+    unsigned char running_status = 0;
+    for (unsigned int i = 0; i < num_events; i++) {
+        Decode(msg, offset, prev_time, running_status);
+        trk->PushEvent(std::move(msg));         // the EOT is skipped by PushEvent()
+    }
+    trk->EndBulkInsert();
+    trk->SetEndTime(end_time);
+}
+
+
+void MIDICompressedTrack::Clear() {
+    std::vector<unsigned char>().swap(data);    // frees the memory
+    std::vector<SeekPoint>().swap(seek_points);
+    num_events = 0;
+    end_time = 0;
+}
+
+
+void MIDICompressedTrack::Encode(const MIDITimedMessage& msg, MIDIClockTime prev_time,
+                                 unsigned char& running_status) {
+    PutVarLen(msg.GetTime() - prev_time);
+    unsigned char status = msg.GetStatus();
+    if (msg.IsChannelMsg()) {
+        if (status != running_status || msg.GetByte1() >= 0x80)
+            data.push_back(status);             // write the status only if needed
+        running_status = status;
+        data.push_back(msg.GetByte1());
+        if (msg.GetLength() > 2)
+            data.push_back(msg.GetByte2());
+    }
+    else {                                      // other messages are stored entirely
+        if (status < 0x80 || status == ESCAPE)
+            data.push_back(ESCAPE);
+        data.push_back(status);
+        data.push_back(msg.GetByte1());
+        data.push_back(msg.GetByte2());
+        data.push_back(msg.GetByte3());
+        const MIDISystemExclusive* sysex = msg.GetSysEx();
+        if (sysex) {                            // length + 1 (0 means no sysex object)
+            PutVarLen(sysex->GetLength() + 1);
+            data.insert(data.end(), sysex->GetBuffer(), sysex->GetBuffer() + sysex->GetLength());
+        }
+        else
+            data.push_back(0);
+    }
+}
+
+
+void MIDICompressedTrack::Decode(MIDITimedMessage& msg, uint32_t& offset, MIDIClockTime& prev_time,
+                                 unsigned char& running_status) const {
+    msg.Clear();
+    prev_time += GetVarLen(offset);
+    msg.SetTime(prev_time);
+    unsigned char status = data[offset];
+    if (status < 0x80) {                        // a data byte: running status
+        status = running_status;
+        msg.SetStatus(status);
+    }
+    else {
+        offset++;
+        if (status == ESCAPE)
+            status = data[offset++];
+        msg.SetStatus(status);
+        if (!msg.IsChannelMsg()) {
+            msg.SetByte1(data[offset++]);
+            msg.SetByte2(data[offset++]);
+            msg.SetByte3(data[offset++]);
+            unsigned long len = GetVarLen(offset);
+            if (len > 0) {
+                msg.AllocateSysEx(len - 1);
+                MIDISystemExclusive* sysex = msg.EditSysEx();
+                for (unsigned long i = 0; i < len - 1; i++)
+                    sysex->PutSysByte(data[offset++]);
+            }
+            return;
+        }
+        running_status = status;
+    }
+    msg.SetByte1(data[offset++]);
+    if (msg.GetLength() > 2)
+        msg.SetByte2(data[offset++]);
+}
+
+
+void MIDICompressedTrack::PutVarLen(unsigned long n) {
+    unsigned char buf[10];
+    int i = 0;
+    buf[i++] = n & 0x7f;
+    while ((n >>= 7) > 0)
+        buf[i++] = (n & 0x7f) | 0x80;
+    while (i > 0)                               // the most significant byte first, as in MIDI files
+        data.push_back(buf[--i]);
+}
+
+
+unsigned long MIDICompressedTrack::GetVarLen(uint32_t& offset) const {
+    unsigned long n = 0;
+    unsigned char c;
+    do {
+        c = data[offset++];
+        n = (n << 7) | (c & 0x7f);
+    } while (c & 0x80);
+    return n;
+}
+
+
+
+/////////////////////////////////////////////////
+//      class MIDICompressedTrackIterator      //
+/////////////////////////////////////////////////
+
+
+MIDICompressedTrackIterator::MIDICompressedTrackIterator(const MIDICompressedTrack* trk) : track(trk) {
+    Reset();
+}
+
+
+void MIDICompressedTrackIterator::Reset() {
+    cur_time = 0;
+    cur_ev_num = 0;
+    offset = 0;
+    prev_time = 0;
+    running_status = 0;
+}
+
+
+void MIDICompressedTrackIterator::SetTrack(const MIDICompressedTrack* trk) {
+    track = trk;
+    Reset();
+}
+
+
+bool MIDICompressedTrackIterator::GoToTime(MIDIClockTime time) {
+    if (time > track->GetEndTime() || track->seek_points.empty()) return false;
+
+    // binary search of the last seek point before the first event with time >= time
+    unsigned int min = 0, max = track->seek_points.size();
+    while (max - min > 1) {
+        unsigned int mid = min + (max - min) / 2;
+        if (track->seek_points[mid].prev_time < time)
+            min = mid;
+        else
+            max = mid;
+    }
+    // go to the seek point, unless we are already between it and the time
+    if (cur_ev_num < track->seek_points[min].ev_num || (cur_ev_num > 0 && prev_time >= time))
+        SetSeekPoint(min);
+
+    MIDIClockTime t;
+    MIDITimedMessage msg;
+    while (GetNextEventTime(&t) && t < time)
+        GetNextEvent(&msg);
+    cur_time = time;
+    return true;
+}
+
+
+bool MIDICompressedTrackIterator::GetNextEvent(MIDITimedMessage* msg) {
+    if (cur_ev_num >= track->GetNumEvents())
+        return false;
+    track->Decode(*msg, offset, prev_time, running_status);
+    cur_time = prev_time;
+    cur_ev_num++;
+    return true;
+}
+
+
+bool MIDICompressedTrackIterator::GetNextEventTime(MIDIClockTime* t) const {
+    if (cur_ev_num >= track->GetNumEvents())
+        return false;  // we are at the end of track
+    uint32_t off = offset;
+    *t = prev_time + track->GetVarLen(off);
+    return true;
+}
+
+
+void MIDICompressedTrackIterator::SetSeekPoint(unsigned int sp) {
+    const MIDICompressedTrack::SeekPoint& point = track->seek_points[sp];
+    cur_ev_num = point.ev_num;
+    offset = point.offset;
+    prev_time = point.prev_time;
+    running_status = point.running_status;
+    cur_time = prev_time;
+}
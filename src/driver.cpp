@@ -25,6 +25,7 @@
 
 #include "../include/driver.h"
 #include "../include/timer.h"
+#include <cstring>
 
 
 /////////////////////////////////////////////////
@@ -32,39 +33,107 @@
 /////////////////////////////////////////////////
 
 
-void MIDIRawMessageQueue::Reset() {
+void MIDIRawMessageQueue::Flush() {
     next_in = next_out = 0;
-    for (unsigned int i = 0; i < buffer.size(); i++)
-        buffer[i] = MIDIRawMessage();
+    num_messages = 0;
+    read_index = read_pos = read_large = 0;
+    large_msgs.clear();
 }
 
 
 void MIDIRawMessageQueue::PutMessage(const MIDIRawMessage& msg) {
-    buffer[next_in] = msg;
-    next_in = (next_in + 1) % buffer.size();
-    if (next_in == next_out)
-        next_out = (next_out + 1) % buffer.size();          // we lose actual out message
+    unsigned int num_packets = MIDIUmp::GetNumPackets(msg.msg);
+    if (num_packets == 0)
+        return;
+    bool large = num_packets > 1 && num_packets > buffer.size() / 4;
+    if (large)                              // stored apart, only its marker goes into the queue
+        num_packets = 1;
+    // free space for the packets, losing the older messages
+    while ((next_in + buffer.size() - next_out) % buffer.size() + num_packets >= buffer.size()) {
+        if (IsLarge(next_out))
+            large_msgs.pop_front();
+        next_out = NextMessage(next_out);
+        num_messages--;
+        read_index = read_large = 0;
+        read_pos = next_out;
+    }
+    for (unsigned int i = 0; i < num_packets; i++) {
+        Record& rec = buffer[next_in];
+        if (large)
+            rec.ump.words[0] = rec.ump.words[1] = 0;    // a utility packet
+        else
+            rec.ump = MIDIUmp::FromMessage(msg.msg, i);
+        rec.timestamp = msg.timestamp;
+        rec.port = msg.port;
+        next_in = (next_in + 1) % buffer.size();
+    }
+    if (large)
+        large_msgs.push_back(msg.msg);      // shares the sysex object with msg, doesn't copy it
+    num_messages++;
 }
 
 
 MIDIRawMessage& MIDIRawMessageQueue::GetMessage() {
-    static MIDIRawMessage msg;      // needed if we want to return a reference
-    if (next_in == next_out)
-        return msg;
+    if (num_messages == 0)
+        out_msg = MIDIRawMessage();
     else {
-        unsigned int old_out = next_out;
-        next_out = (next_out + 1) % buffer.size();
-        return buffer[old_out];
+        if (IsLarge(next_out)) {
+            out_msg.msg = large_msgs.front();
+            large_msgs.pop_front();
+        }
+        next_out = DecodeMessage(next_out, out_msg);
+        num_messages--;
+        read_index = read_large = 0;
+        read_pos = next_out;
     }
+    return out_msg;
 }
 
 
 MIDIRawMessage& MIDIRawMessageQueue::ReadMessage(unsigned int n) {
-    static MIDIRawMessage msg;      // needed if we want to return a reference
-    if (n >= GetLength())
-        return msg;
-    else
-        return buffer[(next_out + n) % buffer.size()];
+    if (n >= num_messages) {
+        out_msg = MIDIRawMessage();
+        return out_msg;
+    }
+    if (n < read_index) {                   // restart from the beginning
+        read_index = read_large = 0;
+        read_pos = next_out;
+    }
+    for ( ; read_index < n; read_index++) {
+        if (IsLarge(read_pos))
+            read_large++;
+        read_pos = NextMessage(read_pos);
+    }
+    if (IsLarge(read_pos))
+        out_msg.msg = large_msgs[read_large++];
+    read_pos = DecodeMessage(read_pos, out_msg);
+    read_index++;
+    return out_msg;
+}
+
+
+unsigned int MIDIRawMessageQueue::NextMessage(unsigned int pos) const {
+    const MIDIUmp& ump = buffer[pos].ump;
+    if (ump.GetMessageType() == MIDIUmp::UMP_DATA64 && ump.GetSysExStatus() == MIDIUmp::PACKET_START) {
+        do                                  // skip the packets of the sysex
+            pos = (pos + 1) % buffer.size();
+        while (pos != next_in && buffer[pos].ump.GetSysExStatus() != MIDIUmp::PACKET_END);
+    }
+    return pos == next_in ? pos : (pos + 1) % buffer.size();
+}
+
+
+unsigned int MIDIRawMessageQueue::DecodeMessage(unsigned int pos, MIDIRawMessage& msg) const {
+    msg.timestamp = buffer[pos].timestamp;
+    msg.port = buffer[pos].port;
+    if (IsLarge(pos))                       // msg.msg was already taken from large_msgs
+        return (pos + 1) % buffer.size();
+    bool complete;
+    do {
+        complete = buffer[pos].ump.ToMessage(msg.msg);
+        pos = (pos + 1) % buffer.size();
+    } while (!complete && pos != next_in);
+    return pos;
 }
 
 
@@ -73,15 +142,20 @@ MIDIRawMessage& MIDIRawMessageQueue::ReadMessage(unsigned int n) {
 /////////////////////////////////////////////////
 
 
-MIDIOutDriver::MIDIOutDriver(int id) :
-    processor(0), port_id(id), num_open(0) {
+MIDIOutDriver::MIDIOutDriver(int id) : MIDIOutDriver(id, RtMidi::UNSPECIFIED) {
+}
+
+
+MIDIOutDriver::MIDIOutDriver(int id, RtMidi::Api api) :
+    processor(0), port_id(id), num_open(0), note_tracking(DRIVER_USES_MIDIMATRIX), skip_redundant(false) {
     try {
-        port = new RtMidiOut();
+        port = new RtMidiOut(api);
     }
     catch (RtMidiError& error) {
         error.printMessage();
         port = new RtMidiOut(RtMidi::RTMIDI_DUMMY);// A non functional MIDI out, which won't throw further exceptions
     }
+    ResetShadow();
 }
 
 
@@ -102,9 +176,8 @@ void MIDIOutDriver::OpenPort() {
     if (num_open == 0) {
         try {
             port->openPort(port_id);
-#if DRIVER_USES_MIDIMATRIX
-            out_matrix.Reset();
-#endif
+            out_notes.Reset();
+            ResetShadow();
         }
         catch (RtMidiError& error) {
             error.printMessage();
@@ -136,35 +209,124 @@ void MIDIOutDriver::ClosePort() {
 }
 
 
-void MIDIOutDriver::AllNotesOff(int chan) {
-    MIDIMessage msg;
+void MIDIOutDriver::SetNoteTracking(bool on) {
+    out_mutex.lock();
+    if (on && !note_tracking)
+        out_notes.Reset();                      // we don't know what is sounding now
+    note_tracking = on;
+    out_mutex.unlock();
+}
 
-    if (!port->isPortOpen())
-        return;
 
-    if (chan == -1) {
-        for (int i = 0; i < 16; i++)
-            AllNotesOff(i);
-        return;
-    }
+void MIDIOutDriver::SetSkipRedundant(bool on) {
+    out_mutex.lock();
+    skip_redundant = on;
+    out_mutex.unlock();
+}
+
+
+void MIDIOutDriver::ResetShadow() {
     out_mutex.lock();
+    memset(shadow_program, -1, sizeof(shadow_program));
+    memset(shadow_pressure, -1, sizeof(shadow_pressure));
+    memset(shadow_controls, -1, sizeof(shadow_controls));
+    for (int i = 0; i < 16; i++)
+        shadow_bender[i] = SHADOW_UNKNOWN_BENDER;
+    out_mutex.unlock();
+}
+
+
+bool MIDIOutDriver::UpdateShadow(const MIDIMessage &msg) {
+    if (msg.IsSysEx()) {
+        if (msg.GetSysEx()->IsGMReset() || msg.GetSysEx()->IsGSReset() || msg.GetSysEx()->IsXGReset())
+            ResetShadow();                          // the device state is changed
+        return true;
+    }
+    if (!msg.IsChannelMsg())
+        return true;
 
-#if DRIVER_USES_MIDIMATRIX                      // send a note off for every note on in the out_matrix
-    if(out_matrix.GetChannelCount(chan) > 0)  {
-        for(int note = 0; note < 128; ++note) {
-            while(out_matrix.GetNoteCount(chan,note) > 0) {
-                msg.SetNoteOff((unsigned char)chan, (unsigned char)note, 0);
-                HardwareMsgOut(msg);
+    int chan = msg.GetChannel();
+    signed char* val = 0;
+    signed char new_val = 0;
+    switch (msg.GetType()) {
+        case PROGRAM_CHANGE:
+            val = &shadow_program[chan];
+            new_val = msg.GetProgramValue();
+            break;
+        case CHANNEL_PRESSURE:
+            val = &shadow_pressure[chan];
+            new_val = msg.GetChannelPressure();
+            break;
+        case PITCH_BEND:
+            if (skip_redundant && shadow_bender[chan] == msg.GetBenderValue())
+                return false;
+            shadow_bender[chan] = msg.GetBenderValue();
+            return true;
+        case CONTROL_CHANGE: {
+            unsigned char ctrl = msg.GetController();
+            if (ctrl == C_RESET) {                  // reset all controllers: we don't know the new values
+                memset(shadow_controls[chan], -1, sizeof(shadow_controls[chan]));
+                shadow_pressure[chan] = -1;
+                shadow_bender[chan] = SHADOW_UNKNOWN_BENDER;
+                return true;
             }
+            if (ctrl >= C_ALL_SOUND_OFF)            // channel mode messages
+                return true;
+            if (ctrl == C_DATA_ENTRY || ctrl == C_DATA_ENTRY + C_LSB ||
+                (ctrl >= C_DATA_INC && ctrl <= C_RPN_MSB))
+                return true;                        // their effect depends on the RPN/NRPN previously sent
+            val = &shadow_controls[chan][ctrl];
+            new_val = msg.GetControllerValue();
+            if (*val != new_val && (ctrl == C_GM_BANK || ctrl == C_GM_BANK + C_LSB))
+                shadow_program[chan] = -1;          // the next program change selects a new bank
+            break;
         }
+        default:
+            return true;
     }
-    msg.SetControlChange(chan,C_DAMPER,0 );     // send a pedal off for every channel
-    HardwareMsgOut(msg);
-#endif // DRIVER_USES_MIDIMATRIX
+    if (skip_redundant && *val == new_val)
+        return false;
+    *val = new_val;
+    return true;
+}
+
+
+// The all notes off messages for every channel (initialized at compile time).
+static const MIDIMessage all_notes_off[16] = {
+    MIDIShortMsg::AllNotesOff(0),  MIDIShortMsg::AllNotesOff(1),  MIDIShortMsg::AllNotesOff(2),
+    MIDIShortMsg::AllNotesOff(3),  MIDIShortMsg::AllNotesOff(4),  MIDIShortMsg::AllNotesOff(5),
+    MIDIShortMsg::AllNotesOff(6),  MIDIShortMsg::AllNotesOff(7),  MIDIShortMsg::AllNotesOff(8),
+    MIDIShortMsg::AllNotesOff(9),  MIDIShortMsg::AllNotesOff(10), MIDIShortMsg::AllNotesOff(11),
+    MIDIShortMsg::AllNotesOff(12), MIDIShortMsg::AllNotesOff(13), MIDIShortMsg::AllNotesOff(14),
+    MIDIShortMsg::AllNotesOff(15)
+};
 
-    msg.SetAllNotesOff( (unsigned char)chan );
-    HardwareMsgOut(msg);
 
+void MIDIOutDriver::AllNotesOff(int chan) {
+    if (!IsPortOpen())
+        return;
+
+    out_mutex.lock();
+    int first = (chan == -1 ? 0 : chan);
+    int last = (chan == -1 ? 15 : chan);
+    for (int ch = first; ch <= last; ch++) {
+        if (note_tracking) {                    // send a note off only for the sounding notes
+            if (!out_notes.IsChannelActive(ch))
+                continue;
+            for (int note = out_notes.GetNextNoteOn(ch, 0); note != -1;
+                 note = out_notes.GetNextNoteOn(ch, note + 1))
+                HardwareMsgOut(MIDIMessage::GetNoteOnv0ForOff() ?
+                               MIDIShortMsg::NoteOn(ch, note, 0) : MIDIShortMsg::NoteOff(ch, note, 0));
+            if (out_notes.GetHoldPedal(ch)) {
+                const MIDIMessage damper_off(MIDIShortMsg::ControlChange(ch, C_DAMPER, 0));
+                UpdateShadow(damper_off);
+                HardwareMsgOut(damper_off);
+            }
+            out_notes.ClearChannel(ch);
+        }
+        else
+            HardwareMsgOut(all_notes_off[ch]);
+    }
     out_mutex.unlock();
 }
 
@@ -172,13 +334,14 @@ void MIDIOutDriver::AllNotesOff(int chan) {
 void MIDIOutDriver::OutputMessage(const MIDITimedMessage& msg) {    // MIDITimedMessage is good also for MIDIMessage
     MIDITimedMessage msg_copy(msg);
 
-    if (processor)
-        processor->Process(&msg_copy);
+    if (processor && !processor->Process(&msg_copy))
+        return;                                     // filtered by the processor
 
     int i = 0;
     for( ; i < DRIVER_MAX_RETRIES; i++) {
         if (out_mutex.try_lock()) {
-            HardwareMsgOut(msg_copy);
+            if (UpdateShadow(msg_copy))
+                HardwareMsgOut(msg_copy);
             out_mutex.unlock();
             break;
         }
@@ -194,30 +357,27 @@ void MIDIOutDriver::HardwareMsgOut(const MIDIMessage &msg) {
     if (!port->isPortOpen())
         return;
     msg_bytes.clear();
-#if DRIVER_USES_MIDIMATRIX
-    if (msg.IsChannelMsg()) {
-        MIDITimedMessage tmsg(msg);
-        out_matrix.Process (&tmsg);
-    }
-#endif
+    TrackNotes(msg);
+    uint16_t cat = msg.Classify();
 
-    if (msg.IsSysEx()) {
-        for (int i = 0; i < msg.GetSysEx()->GetLength(); i++)
-            msg_bytes.push_back(msg.GetSysEx()->GetData(i));
+    if (cat & MSG_SYSEX) {
+        const unsigned char* buf = msg.GetSysEx()->GetBuffer();
+        msg_bytes.assign(buf, buf + msg.GetSysEx()->GetLength());
         //std::cout << "Driver sent sysex of " << msg.GetSysEx()->GetLength() << " bytes ... ";
     }
 
     //else if (msg.IsReset())         // a reset message, with the same status of meta events
     //    msg_bytes.push_back(msg.GetStatus()) TODO: for now don't send reset messages
 
-    else if (msg.IsMetaEvent())
-        return;                     // don't send meta events
+    else if (cat & (MSG_META | MSG_SERVICE))
+        return;                     // don't send meta events and service messages
 
     else {                          // other messages
+        int len = msg.GetLength();
         msg_bytes.push_back(msg.GetStatus());
-        if (msg.GetLength() > 1)
+        if (len > 1)
             msg_bytes.push_back(msg.GetByte1());
-        if (msg.GetLength() > 2)
+        if (len > 2)
             msg_bytes.push_back(msg.GetByte2());
     }
 
@@ -241,9 +401,14 @@ void MIDIOutDriver::HardwareMsgOut(const MIDIMessage &msg) {
 
 
 MIDIInDriver::MIDIInDriver(int id, unsigned int queue_size) :
+    MIDIInDriver(id, RtMidi::UNSPECIFIED, queue_size) {
+}
+
+
+MIDIInDriver::MIDIInDriver(int id, RtMidi::Api api, unsigned int queue_size) :
     processor(0), port_id(id), num_open(0), in_queue(queue_size) {
     try {
-        port = new RtMidiIn();
+        port = new RtMidiIn(api);
         port->setCallback(HardwareMsgIn, this);
         port->ignoreTypes(false, true, true);
     }
@@ -349,20 +514,7 @@ void MIDIInDriver::HardwareMsgIn(double time,
 
     drv->in_mutex.lock();
     MIDITimedMessage msg;
-    msg.SetStatus(msg_bytes->operator[](0));        // in msg_bytes[0] there is the status byte
-    if (msg.IsSysEx()) {
-        msg.AllocateSysEx(msg_bytes->size());
-        for (unsigned int i = 0; i < msg_bytes->size(); i++)
-            msg.GetSysEx()->PutSysByte(msg_bytes->operator[](i));   // puts the 0xf0 also in the sysex buffer
-    }
-    else if (msg.GetStatus() == 0xff) { // this is a reset message, NOT a meta
-    }
-    else {
-        if (msg.GetLength() > 1)
-            msg.SetByte1(msg_bytes->operator[](1));
-        if (msg.GetLength() > 2)
-            msg.SetByte2(msg_bytes->operator[](2)); // byte3 surely 0 in non-meta messages
-    }
+    DecodeMessage(msg_bytes->data(), msg_bytes->size(), msg);
 
     if (!msg.IsNoOp()) {                            // now we have a valid message
 
@@ -378,3 +530,25 @@ void MIDIInDriver::HardwareMsgIn(double time,
         std::cout << "No message, queue size: " << drv->in_queue.GetLength() << std::endl;
     drv->in_mutex.unlock();
 }
+
+
+bool MIDIInDriver::DecodeMessage(const unsigned char* bytes, unsigned int len, MIDITimedMessage& msg) {
+    msg.Clear();
+    if (len == 0)
+        return false;
+    msg.SetStatus(bytes[0]);                        // in bytes[0] there is the status byte
+    if (msg.IsSysEx()) {
+        msg.AllocateSysEx(len);
+        for (unsigned int i = 0; i < len; i++)
+            msg.EditSysEx()->PutSysByte(bytes[i]);   // puts the 0xf0 also in the sysex buffer
+    }
+    else if (msg.GetStatus() == 0xff) { // this is a reset message, NOT a meta
+    }
+    else {
+        if (msg.GetLength() > 1 && len > 1)
+            msg.SetByte1(bytes[1]);
+        if (msg.GetLength() > 2 && len > 2)
+            msg.SetByte2(bytes[2]);                 // byte3 surely 0 in non-meta messages
+    }
+    return !msg.IsNoOp();
+}
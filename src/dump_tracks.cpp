@@ -48,8 +48,11 @@ void SetChanFrom(unsigned char c) {
 
 
 void DumpMIDITimedMessage (MIDITimedMessage* const msg, std::ostream& ost) {
-    if (msg)
-        ost << msg->MsgToText(chan_from_1) << std::endl;
+    if (msg) {
+        char buf[MIDIMessage::TEXT_BUFFER_SIZE];
+        msg->MsgToText(buf, MIDIMessage::TEXT_BUFFER_SIZE, chan_from_1);
+        ost << buf << std::endl;
+    }
 }
 
 
@@ -0,0 +1,115 @@
+/*
+ *   NiCMidi - A C++ Class Library for MIDI
+ *
+ *   Copyright (C) 2021, 2022  Nicola Cassetta
+ *   https://github.com/ncassetta/NiCMidi
+ *
+ *   This file is part of NiCMidi.
+ *
+ *   NiCMidi is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   NiCMidi is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with NiCMidi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "../include/eventbuffer.h"
+#include <algorithm>            // for std::move_backward(), std::max()
+
+
+/////////////////////////////////////////////////
+//            class MIDIEventBuffer            //
+/////////////////////////////////////////////////
+
+
+MIDIEventBuffer::MIDIEventBuffer(const MIDIEventBuffer& buf) : gap_start(0), gap_end(0) {
+    *this = buf;
+}
+
+
+MIDIEventBuffer& MIDIEventBuffer::operator=(const MIDIEventBuffer& buf) {
+    if (this != &buf) {
+        std::vector<MIDITimedMessage> new_buffer;
+        new_buffer.reserve(buf.size());
+        new_buffer.insert(new_buffer.end(), buf.buffer.begin(), buf.buffer.begin() + buf.gap_start);
+        new_buffer.insert(new_buffer.end(), buf.buffer.begin() + buf.gap_end, buf.buffer.end());
+        buffer.swap(new_buffer);
+        gap_start = gap_end = buffer.size();
+    }
+    return *this;
+}
+
+
+MIDITimedMessage* MIDIEventBuffer::data() {
+    MoveGap(size());
+    return buffer.data();
+}
+
+
+void MIDIEventBuffer::reserve(unsigned int n) {
+    if (n <= buffer.size())
+        return;
+    std::vector<MIDITimedMessage> new_buffer(n);
+    unsigned int after_gap = buffer.size() - gap_end;
+    std::move(buffer.begin(), buffer.begin() + gap_start, new_buffer.begin());
+    std::move(buffer.begin() + gap_end, buffer.end(), new_buffer.end() - after_gap);
+    buffer.swap(new_buffer);
+    gap_end = n - after_gap;
+}
+
+
+void MIDIEventBuffer::clear() {
+    for (unsigned int i = 0; i < buffer.size(); i++)
+        buffer[i].Clear();          // frees the sysex, but keeps the memory of the buffer
+    gap_start = 0;
+    gap_end = buffer.size();
+}
+
+
+void MIDIEventBuffer::insert(unsigned int pos, MIDITimedMessage&& msg) {
+    if (gap_start == gap_end)       // the buffer is full
+        reserve(buffer.size() < 8 ? 16 : 2 * buffer.size());
+    MoveGap(pos);
+    buffer[gap_start++] = std::move(msg);
+}
+
+
+void MIDIEventBuffer::insert(unsigned int pos, const MIDIEventBuffer& src, unsigned int first, unsigned int n) {
+    if (gap_end - gap_start < n)    // the gap is too small
+        reserve(std::max(size() + n, 2 * (unsigned int)buffer.size()));
+    MoveGap(pos);
+    for (unsigned int i = first; i < first + n; i++)
+        buffer[gap_start++] = src[i];
+}
+
+
+void MIDIEventBuffer::erase(unsigned int pos, unsigned int n) {
+    MoveGap(pos);
+    for (unsigned int i = gap_end; i < gap_end + n; i++)
+        buffer[i].Clear();
+    gap_end += n;
+}
+
+
+void MIDIEventBuffer::MoveGap(unsigned int pos) {
+    if (pos < gap_start) {          // moves the events between pos and the gap after it
+        std::move_backward(buffer.begin() + pos, buffer.begin() + gap_start, buffer.begin() + gap_end);
+        gap_end -= gap_start - pos;
+        gap_start = pos;
+    }
+    else if (pos > gap_start) {     // moves the events between the gap and pos before it
+        unsigned int n = pos - gap_start;
+        std::move(buffer.begin() + gap_end, buffer.begin() + gap_end + n, buffer.begin() + gap_start);
+        gap_start += n;
+        gap_end += n;
+    }
+}
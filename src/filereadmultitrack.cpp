@@ -24,10 +24,17 @@
 
 
 #include "../include/filereadmultitrack.h"
+#include <utility>
 
 
 MIDIFileReadMultiTrack::MIDIFileReadMultiTrack (MIDIMultiTrack *mlttrk) :
-    multitrack(mlttrk), cur_track(-1) {}
+    multitrack(mlttrk), cur_track(-1), loading(false) {}
+
+
+MIDIFileReadMultiTrack::~MIDIFileReadMultiTrack() {
+    if (loading)                    // the parsing was aborted: sort the events read so far
+        EndLoading();
+}
 
 
 
@@ -38,7 +45,7 @@ void MIDIFileReadMultiTrack::mf_sysex(MIDIClockTime time, const MIDISystemExclus
     msg.SetSysEx(&ex);
     msg.SetTime(time);
 
-    multitrack->InsertEvent(cur_track, msg, INSMODE_INSERT);
+    PushEvent(cur_track, std::move(msg));
 }
 
 
@@ -59,7 +66,7 @@ void MIDIFileReadMultiTrack::mf_meta16( MIDIClockTime time, int type, int b1, in
 
     msg.SetMetaEvent(type, b1, b2);
     msg.SetTime(time);
-    multitrack->InsertEvent(cur_track, msg, INSMODE_INSERT);
+    PushEvent(cur_track, std::move(msg));
 }
 
 
@@ -69,7 +76,7 @@ void MIDIFileReadMultiTrack::mf_smpte( MIDIClockTime time, int h, int m, int s,
 
     msg.SetSMPTEOffset(h, m, s, f, sf);
     msg.SetTime(time);
-    multitrack->InsertEvent(cur_track, msg, INSMODE_INSERT);
+    PushEvent(cur_track, std::move(msg));
 }
 
 
@@ -82,7 +89,7 @@ void MIDIFileReadMultiTrack::mf_timesig(MIDIClockTime time, int num, int denom_p
     msg.SetTimeSig((unsigned char)num, (unsigned char)denom,
                    (unsigned char)clks_per_metro, (unsigned char)notated_32nd_per_quarter);
     msg.SetTime(time);
-    multitrack->InsertEvent(cur_track, msg, INSMODE_INSERT);
+    PushEvent(cur_track, std::move(msg));
 }
 
 
@@ -90,13 +97,13 @@ void MIDIFileReadMultiTrack::mf_tempo(MIDIClockTime time, int m1, int m2, int m3
     MIDITimedMessage msg;
     msg.SetMetaEvent(META_TEMPO, 0);
     msg.AllocateSysEx(3);
-    msg.GetSysEx()->PutSysByte(m1);
-    msg.GetSysEx()->PutSysByte(m2);
-    msg.GetSysEx()->PutSysByte(m3);
+    msg.EditSysEx()->PutSysByte(m1);
+    msg.EditSysEx()->PutSysByte(m2);
+    msg.EditSysEx()->PutSysByte(m3);
     //msg.SetTempo32( static_cast<unsigned short>(tempo_bpm_times_32) );
     msg.SetTime(time);
 
-    multitrack->InsertEvent(cur_track, msg, INSMODE_INSERT);
+    PushEvent(cur_track, std::move(msg));
   }
 
 
@@ -106,7 +113,7 @@ void MIDIFileReadMultiTrack::mf_keysig(MIDIClockTime time, int c, int v ) {
     msg.SetKeySig( (unsigned char)c, (unsigned char)v );
     msg.SetTime( time );
 
-    multitrack->InsertEvent(cur_track, msg, INSMODE_INSERT);
+    PushEvent(cur_track, std::move(msg));
 }
 
 
@@ -124,9 +131,9 @@ void MIDIFileReadMultiTrack::mf_text( MIDIClockTime time, int type, int len, uns
     msg.AllocateSysEx(len);
 
     for( int i=0; i<len; ++i )
-        msg.GetSysEx()->PutSysByte( s[i] );
+        msg.EditSysEx()->PutSysByte( s[i] );
 
-    multitrack->InsertEvent(cur_track, msg, INSMODE_INSERT);
+    PushEvent(cur_track, std::move(msg));
 }
 
 
@@ -151,6 +158,8 @@ void MIDIFileReadMultiTrack::mf_starttrack (int trk) {
 
 void MIDIFileReadMultiTrack::mf_endtrack (int trk) {
     cur_track = -1;
+    if (trk == header.ntrks - 1)    // last track: all the events have been read
+        EndLoading();
 }
 
 
@@ -165,6 +174,11 @@ void MIDIFileReadMultiTrack::mf_header (int format_, int ntrks_, int division_)
     else
         multitrack->Reset(header.ntrks); //
     multitrack->SetClksPerBeat( header.division );
+
+    // events are pushed into the tracks unsorted and sorted at once at the end
+    for (unsigned int i = 0; i < multitrack->GetNumTracks(); i++)
+        multitrack->GetTrack(i)->BeginBulkInsert();
+    loading = true;
 }
 
 
@@ -173,10 +187,23 @@ void MIDIFileReadMultiTrack::ChanMessage( const MIDITimedMessage &msg ) {
         // split format 0 files into separate tracks, one for each channel,
         // keep track 0 for tempo and meta-events
 
-        multitrack->InsertEvent(msg.GetChannel() + 1, msg, INSMODE_INSERT);
+        PushEvent(msg.GetChannel() + 1, MIDITimedMessage(msg));
     }
     else
-        multitrack->InsertEvent(cur_track, msg, INSMODE_INSERT);
+        PushEvent(cur_track, MIDITimedMessage(msg));
+}
+
+
+void MIDIFileReadMultiTrack::PushEvent(int trk, MIDITimedMessage&& msg) {
+    if (multitrack->IsValidTrackNumber(trk))
+        multitrack->GetTrack(trk)->PushEvent(std::move(msg));
+}
+
+
+void MIDIFileReadMultiTrack::EndLoading() {
+    for (unsigned int i = 0; i < multitrack->GetNumTracks(); i++)
+        multitrack->GetTrack(i)->EndBulkInsert();
+    loading = false;
 }
 
 
@@ -0,0 +1,297 @@
+/*
+ *   NiCMidi - A C++ Class Library for MIDI
+ *
+ *   Copyright (C) 2021, 2022  Nicola Cassetta
+ *   https://github.com/ncassetta/NiCMidi
+ *
+ *   This file is part of NiCMidi.
+ *
+ *   NiCMidi is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   NiCMidi is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with NiCMidi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "../include/jackdriver.h"
+
+#ifdef __UNIX_JACK__
+
+#include <iostream>
+
+
+/////////////////////////////////////////////////
+//           class MIDIJackOutDriver           //
+/////////////////////////////////////////////////
+
+
+thread_local MIDIJackOutDriver* MIDIJackOutDriver::callback_driver = 0;
+
+
+MIDIJackOutDriver::MIDIJackOutDriver(int id, const std::string& name, bool sync) :
+    MIDIOutDriver(id, RtMidi::RTMIDI_DUMMY), client_name(name), client(0), jack_port(0),
+    sync_mode(sync), sample_rate(0), cycle_buffer(0), cycle_frames(0), last_offset(0),
+    cycle_start(0.0), base_time(0.0), base_frame(0), base_set(false), deferred_notes_off(0), num_lost(0) {
+    deferred.reserve(MAX_DEFERRED);     // the JACK thread must not allocate memory
+}
+
+
+MIDIJackOutDriver::~MIDIJackOutDriver() {
+    Reset();
+}
+
+
+void MIDIJackOutDriver::Reset() {
+    CloseClient();
+    processor = 0;
+    num_open = 0;
+}
+
+
+std::string MIDIJackOutDriver::GetPortName() {
+    if (jack_port)
+        return jack_port_name(jack_port);
+    return client_name + ":midi_out";
+}
+
+
+void MIDIJackOutDriver::SetSyncMode(bool on) {
+    if (on == sync_mode)
+        return;
+    sync_mode = on;
+    if (client)
+        MIDITimer::SetExternalClock(on);
+}
+
+
+void MIDIJackOutDriver::OpenPort() {
+    if (num_open == 0) {
+        client = jack_client_open(client_name.c_str(), JackNoStartServer, 0);
+        if (client == 0) {
+            std::cerr << "MIDIJackOutDriver: cannot open JACK client (is jackd running?)" << std::endl;
+            return;
+        }
+        jack_port = jack_port_register(client, "midi_out", JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput, 0);
+        if (jack_port == 0) {
+            std::cerr << "MIDIJackOutDriver: cannot register JACK MIDI port" << std::endl;
+            jack_client_close(client);
+            client = 0;
+            return;
+        }
+        sample_rate = jack_get_sample_rate(client);
+        base_set = false;
+        deferred.clear();
+        deferred_notes_off = 0;
+        num_lost = 0;
+        jack_set_process_callback(client, ProcessCallback, this);
+        if (jack_activate(client) != 0) {
+            std::cerr << "MIDIJackOutDriver: cannot activate JACK client" << std::endl;
+            jack_client_close(client);
+            client = 0;
+            jack_port = 0;
+            return;
+        }
+        if (sync_mode)
+            MIDITimer::SetExternalClock(true);
+        out_notes.Reset();
+        ResetShadow();
+    }
+    num_open++;
+
+    std::cout << "OUT Port " << GetPortName() << " open";
+    if (num_open > 1)
+        std::cout << " (" << num_open << " times)";
+    std::cout<< std::endl;
+}
+
+
+void MIDIJackOutDriver::ClosePort() {
+    if (num_open == 1)
+        CloseClient();
+    if (num_open > 0) {
+        num_open--;
+        std::cout << "OUT Port " << GetPortName() << " closed";
+        if (num_open > 0)
+            std::cout << " (open " << num_open << " times)";
+        std::cout << std::endl;
+    }
+    else
+        std::cout << "OUT Port " << GetPortName()
+        << "Attempt to close an already closed port!" << std::endl;
+}
+
+
+void MIDIJackOutDriver::AllNotesOff(int chan) {
+    if (callback_driver != this) {
+        MIDIOutDriver::AllNotesOff(chan);
+        return;
+    }
+    if (!out_mutex.try_lock()) {        // don't wait in the JACK thread: retry in the next period
+        deferred_notes_off |= (chan == -1 ? 0xffff : 1 << chan);
+        return;
+    }
+    MIDIOutDriver::AllNotesOff(chan);   // locks again out_mutex, which is recursive
+    out_mutex.unlock();
+}
+
+
+void MIDIJackOutDriver::OutputMessage(const MIDITimedMessage& msg) {
+    if (callback_driver != this) {
+        MIDIOutDriver::OutputMessage(msg);
+        return;
+    }
+    MIDITimedMessage msg_copy(msg);
+    if (processor && !processor->Process(&msg_copy))
+        return;                                     // filtered by the processor
+    CallbackOutput(msg_copy, last_offset);
+}
+
+
+void MIDIJackOutDriver::OutputTimedMessage(const MIDITimedMessage& msg, double sys_time) {
+    if (callback_driver != this) {
+        OutputMessage(msg);         // not called in the process callback: send at next period
+        return;
+    }
+    MIDITimedMessage msg_copy(msg);
+    if (processor && !processor->Process(&msg_copy))
+        return;                                     // filtered by the processor
+    double offs = (sys_time - cycle_start) * sample_rate / 1000.0;
+    CallbackOutput(msg_copy, offs < 0.0 ? 0 : (jack_nframes_t)offs);
+}
+
+
+void MIDIJackOutDriver::HardwareMsgOut(const MIDIMessage &msg) {
+    if (!client || !MsgToBytes(msg))
+        return;
+    if (callback_driver == this)                    // out_mutex is locked by CallbackOutput() or AllNotesOff()
+        WriteToCycle(last_offset);
+    else {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        pending.push_back(bytes);
+    }
+}
+
+
+void MIDIJackOutDriver::CloseClient() {
+    if (client) {
+        jack_deactivate(client);
+        jack_client_close(client);
+        client = 0;
+        jack_port = 0;
+        if (sync_mode)
+            MIDITimer::SetExternalClock(false);
+    }
+}
+
+
+bool MIDIJackOutDriver::MsgToBytes(const MIDIMessage& msg) {
+    bytes.clear();
+    TrackNotes(msg);
+    if (msg.IsSysEx())
+        bytes.assign(msg.GetSysEx()->GetBuffer(), msg.GetSysEx()->GetBuffer() + msg.GetSysEx()->GetLength());
+    else if (msg.IsMetaEvent())
+        return false;               // don't send meta events
+    else {
+        bytes.push_back(msg.GetStatus());
+        if (msg.GetLength() > 1)
+            bytes.push_back(msg.GetByte1());
+        if (msg.GetLength() > 2)
+            bytes.push_back(msg.GetByte2());
+    }
+    return bytes.size() > 0;
+}
+
+
+void MIDIJackOutDriver::CallbackOutput(const MIDITimedMessage& msg, jack_nframes_t offset) {
+    if (!out_mutex.try_lock()) {        // another thread is using the driver: send in the next period
+        if (deferred.size() < deferred.capacity())
+            deferred.push_back(msg);
+        else
+            num_lost++;
+        return;
+    }
+    if (UpdateShadow(msg) && MsgToBytes(msg))
+        WriteToCycle(offset);
+    out_mutex.unlock();
+}
+
+
+void MIDIJackOutDriver::SendDeferred() {
+    if ((deferred.empty() && deferred_notes_off == 0) || !out_mutex.try_lock())
+        return;                         // still locked: retry in the next period
+    for (unsigned int i = 0; i < deferred.size(); i++)
+        if (UpdateShadow(deferred[i]) && MsgToBytes(deferred[i]))
+            WriteToCycle(0);
+    deferred.clear();
+    if (deferred_notes_off == 0xffff)
+        MIDIOutDriver::AllNotesOff();
+    else
+        for (int ch = 0; ch < 16; ch++)
+            if (deferred_notes_off & (1 << ch))
+                MIDIOutDriver::AllNotesOff(ch);
+    deferred_notes_off = 0;
+    out_mutex.unlock();
+}
+
+
+void MIDIJackOutDriver::WriteToCycle(jack_nframes_t offset) {
+    if (offset >= cycle_frames)
+        offset = cycle_frames - 1;
+    if (offset < last_offset)       // JACK wants events in time order
+        offset = last_offset;
+    if (jack_midi_event_write(cycle_buffer, offset, bytes.data(), bytes.size()) != 0)
+        num_lost++;                 // JACK MIDI buffer full (no I/O in the JACK thread)
+    last_offset = offset;
+}
+
+
+int MIDIJackOutDriver::ProcessCallback(jack_nframes_t nframes, void* p) {
+    MIDIJackOutDriver* drv = static_cast<MIDIJackOutDriver*>(p);
+
+    callback_driver = drv;
+    drv->cycle_buffer = jack_port_get_buffer(drv->jack_port, nframes);
+    jack_midi_clear_buffer(drv->cycle_buffer);
+    drv->cycle_frames = nframes;
+    drv->last_offset = 0;
+
+    // messages put aside in the previous period
+    drv->SendDeferred();
+    // messages sent by other threads go at the start of the period (if the queue is locked
+    // we don't wait, they will be sent in the next one)
+    if (drv->pending_mutex.try_lock()) {
+        unsigned int written = 0;
+        for ( ; written < drv->pending.size(); written++)
+            if (jack_midi_event_write(drv->cycle_buffer, 0, drv->pending[written].data(),
+                                      drv->pending[written].size()) != 0)
+                break;              // buffer full: the others remain for the next period
+        drv->pending.erase(drv->pending.begin(), drv->pending.begin() + written);
+        drv->pending_mutex.unlock();
+    }
+
+    if (drv->sync_mode) {
+        // the system time of the period is derived from the frame count, so it has no jitter
+        jack_nframes_t frame = jack_last_frame_time(drv->client);
+        if (!drv->base_set) {
+            drv->base_time = (double)MIDITimer::GetSysTimeMs();
+            drv->base_frame = frame;
+            drv->base_set = true;
+        }
+        drv->cycle_start = drv->base_time + (jack_nframes_t)(frame - drv->base_frame) * 1000.0 / drv->sample_rate;
+        // the sequencer outputs all the messages due before the end of the period
+        MIDITimer::ExternalTick((tMsecs)(drv->cycle_start + nframes * 1000.0 / drv->sample_rate));
+    }
+
+    drv->cycle_buffer = 0;
+    callback_driver = 0;
+    return 0;
+}
+
+#endif // __UNIX_JACK__
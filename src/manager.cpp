@@ -126,6 +126,28 @@ bool MIDIManager::IsValidOutPortNumber(unsigned int n) {
 }
 
 
+unsigned int MIDIManager::AddInDriver(MIDIInDriver* drv) {
+    if (!init)
+        Init();
+    proc_lock->lock();          // TickProc() scans the MIDI_ins vector
+    MIDI_ins->push_back(drv);
+    MIDI_in_names->push_back(drv->GetPortName());
+    proc_lock->unlock();
+    return MIDI_ins->size() - 1;
+}
+
+
+unsigned int MIDIManager::AddOutDriver(MIDIOutDriver* drv) {
+    if (!init)
+        Init();
+    proc_lock->lock();
+    MIDI_outs->push_back(drv);
+    MIDI_out_names->push_back(drv->GetPortName());
+    proc_lock->unlock();
+    return MIDI_outs->size() - 1;
+}
+
+
 MIDISequencer* MIDIManager::GetSequencer() {
     if (!init)
         Init();
@@ -252,6 +274,11 @@ void MIDIManager::TickProc(tMsecs sys_time, void* p) {
             tp->GetFunc()(sys_time, tp);
     }
 
+    // sends the messages buffered by the out drivers during this tick
+    for (unsigned int i = 0; i < MIDI_outs->size(); i++)
+        if ((*MIDI_outs)[i]->IsPortOpen())
+            (*MIDI_outs)[i]->FlushOutput();
+
     for (unsigned int i = 0; i < MIDI_ins->size(); i++)
         if ((*MIDI_ins)[i]->IsPortOpen())
             (*MIDI_ins)[i]->FlushQueue();
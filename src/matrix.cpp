@@ -129,3 +129,91 @@ void MIDIMatrix::ClearChannel(unsigned char chan) {
     channel_count[chan] = 0;
     hold_pedal[chan] = 0;
 }
+
+
+
+/////////////////////////////////////////////////
+//          class MIDINoteBitMatrix            //
+/////////////////////////////////////////////////
+
+
+void MIDINoteBitMatrix::Reset() {
+    memset(notes, 0, sizeof(notes));
+    channel_mask = 0;
+    pedal_mask = 0;
+}
+
+
+bool MIDINoteBitMatrix::Update(const MIDIMessage& msg) {
+    if (!msg.IsChannelMsg())
+        return false;
+    int chan = msg.GetChannel();
+
+    if (msg.IsNoteOn()) {
+        unsigned char note = msg.GetNote();
+        notes[chan][note >> 6] |= (uint64_t)1 << (note & 63);
+        channel_mask |= 1 << chan;
+        return true;
+    }
+    if (msg.IsNoteOff()) {
+        unsigned char note = msg.GetNote();
+        notes[chan][note >> 6] &= ~((uint64_t)1 << (note & 63));
+        UpdateChannelMask(chan);
+        return true;
+    }
+    if (msg.IsAllNotesOff()) {
+        ClearChannel(chan);
+        return true;
+    }
+    if (msg.IsPedalOn()) {
+        pedal_mask |= 1 << chan;
+        channel_mask |= 1 << chan;
+        return true;
+    }
+    if (msg.IsPedalOff()) {
+        pedal_mask &= ~(1 << chan);
+        UpdateChannelMask(chan);
+        return true;
+    }
+    return false;
+}
+
+
+int MIDINoteBitMatrix::GetChannelCount(int chan) const {
+    int count = 0;
+    for (int note = GetNextNoteOn(chan, 0); note != -1; note = GetNextNoteOn(chan, note + 1))
+        count++;
+    return count;
+}
+
+
+int MIDINoteBitMatrix::GetNextNoteOn(int chan, int note) const {
+    for ( ; note < 128; note = (note | 63) + 1) {
+        uint64_t bits = notes[chan][note >> 6] >> (note & 63);
+        if (bits) {
+#ifdef __GNUC__
+            return note + __builtin_ctzll(bits);
+#else
+            while (!(bits & 1)) {
+                bits >>= 1;
+                note++;
+            }
+            return note;
+#endif // __GNUC__
+        }
+    }
+    return -1;
+}
+
+
+void MIDINoteBitMatrix::ClearChannel(int chan) {
+    notes[chan][0] = notes[chan][1] = 0;
+    pedal_mask &= ~(1 << chan);
+    channel_mask &= ~(1 << chan);
+}
+
+
+void MIDINoteBitMatrix::UpdateChannelMask(int chan) {
+    if (notes[chan][0] == 0 && notes[chan][1] == 0 && !GetHoldPedal(chan))
+        channel_mask &= ~(1 << chan);
+}
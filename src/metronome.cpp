@@ -287,7 +287,6 @@ void Metronome::TickProc(tMsecs sys_time) {
     static unsigned char last_note = 0;
     unsigned char note, vel;
     MIDISequencerGUIEvent ev;
-    MIDIMessage msg_beat;
     //static unsigned int times;
     //times++;
     //if (!(times % 100))
@@ -341,8 +340,7 @@ void Metronome::TickProc(tMsecs sys_time) {
         }
 
         // tell the driver to send the click note on
-        msg_beat.SetNoteOn(chan, note, vel);
-        MIDIManager::GetOutDriver(out_port)->OutputMessage(msg_beat);
+        MIDIManager::GetOutDriver(out_port)->OutputMessage(MIDIShortMsg::NoteOn(chan, note, vel));
         if (notifier)
             notifier->Notify(ev);
         //std::cout << "Note on ... ";
@@ -356,8 +354,9 @@ void Metronome::TickProc(tMsecs sys_time) {
     else if (cur_time >= static_cast<tMsecs>(next_time_off)) {  // we must send the note off
 
         // tell the driver the send the beat note off
-        msg_beat.SetNoteOff(chan, last_note, 0);
-        MIDIManager::GetOutDriver(out_port)->OutputMessage(msg_beat);
+        MIDIManager::GetOutDriver(out_port)->OutputMessage(MIDIMessage::GetNoteOnv0ForOff() ?
+                                                           MIDIShortMsg::NoteOn(chan, last_note, 0) :
+                                                           MIDIShortMsg::NoteOff(chan, last_note, 0));
         next_time_off += msecs_per_beat;
         //std::cout << "Note off" << std::endl;
     }
@@ -26,6 +26,9 @@
 
 
 #include <cstring>      // for strlen()
+#include <cstdio>       // for snprintf()
+#include <cstdarg>
+#include <utility>      // for std::move()
 #include "../include/msg.h"
 
 
@@ -35,19 +38,41 @@
 
 bool MIDIMessage::use_note_onv0 = false;
 
+// the table is computed at compile time from GetStatusInfo()
+#define STATUS_INFO_ROW(r)  GetStatusInfo(r), GetStatusInfo(r + 1), GetStatusInfo(r + 2), GetStatusInfo(r + 3), \
+                            GetStatusInfo(r + 4), GetStatusInfo(r + 5), GetStatusInfo(r + 6), GetStatusInfo(r + 7), \
+                            GetStatusInfo(r + 8), GetStatusInfo(r + 9), GetStatusInfo(r + 10), GetStatusInfo(r + 11), \
+                            GetStatusInfo(r + 12), GetStatusInfo(r + 13), GetStatusInfo(r + 14), GetStatusInfo(r + 15)
+
+const MIDIMessage::StatusInfo MIDIMessage::status_info[256] = {
+    STATUS_INFO_ROW(0x00), STATUS_INFO_ROW(0x10), STATUS_INFO_ROW(0x20), STATUS_INFO_ROW(0x30),
+    STATUS_INFO_ROW(0x40), STATUS_INFO_ROW(0x50), STATUS_INFO_ROW(0x60), STATUS_INFO_ROW(0x70),
+    STATUS_INFO_ROW(0x80), STATUS_INFO_ROW(0x90), STATUS_INFO_ROW(0xa0), STATUS_INFO_ROW(0xb0),
+    STATUS_INFO_ROW(0xc0), STATUS_INFO_ROW(0xd0), STATUS_INFO_ROW(0xe0), STATUS_INFO_ROW(0xf0)
+};
+
+#undef STATUS_INFO_ROW
+
 
 //
 // constructors
 //
 
-MIDIMessage::MIDIMessage() : status(0), byte1(0), byte2(0) , byte3(0), sysex(0)
+MIDIMessage::MIDIMessage() : sysex(0), status(0), byte1(0), byte2(0) , byte3(0)
 {}
 
 
 MIDIMessage::MIDIMessage(const MIDIMessage &msg) :
-    status(msg.status), byte1(msg.byte1), byte2(msg.byte2), byte3(msg.byte3), sysex(0) {
-    if(msg.sysex)
-        sysex = new MIDISystemExclusive(*msg.sysex);
+    sysex(msg.sysex), status(msg.status), byte1(msg.byte1), byte2(msg.byte2), byte3(msg.byte3) {
+    if (sysex)
+        sysex->ref_count.fetch_add(1, std::memory_order_relaxed);   // share the object
+}
+
+
+MIDIMessage::MIDIMessage(MIDIMessage &&msg) noexcept :
+    sysex(msg.sysex), status(msg.status), byte1(msg.byte1), byte2(msg.byte2), byte3(msg.byte3) {
+    msg.status = msg.byte1 = msg.byte2 = msg.byte3 = 0;
+    msg.sysex = 0;
 }
 
 
@@ -64,11 +89,22 @@ void MIDIMessage::Clear() {
 
 void MIDIMessage::ClearSysEx() {
     if (sysex) {
-        delete sysex;
+        if (sysex->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete sysex;                       // we were the last owner
         sysex = 0;
     }
 }
 
+
+MIDISystemExclusive* MIDIMessage::EditSysEx() {
+    if (sysex && sysex->ref_count.load(std::memory_order_acquire) > 1) {
+        MIDISystemExclusive* own = new MIDISystemExclusive(*sysex);
+        ClearSysEx();                           // copy on write
+        sysex = own;
+    }
+    return sysex;
+}
+
 //
 // operator =
 //
@@ -79,9 +115,25 @@ const MIDIMessage& MIDIMessage::operator= (const MIDIMessage &msg) {
         byte1 = msg.byte1;
         byte2 = msg.byte2;
         byte3 = msg.byte3;
+        if (msg.sysex)
+            msg.sysex->ref_count.fetch_add(1, std::memory_order_relaxed);
+        ClearSysEx();
+        sysex = msg.sysex;
+    }
+    return *this;
+}
+
+
+const MIDIMessage& MIDIMessage::operator= (MIDIMessage &&msg) noexcept {
+    if (this != &msg) {
+        status = msg.status;
+        byte1 = msg.byte1;
+        byte2 = msg.byte2;
+        byte3 = msg.byte3;
         ClearSysEx();
-        if(msg.sysex)
-            sysex = new MIDISystemExclusive(*msg.sysex);
+        sysex = msg.sysex;
+        msg.status = msg.byte1 = msg.byte2 = msg.byte3 = 0;
+        msg.sysex = 0;
     }
     return *this;
 }
@@ -91,14 +143,6 @@ const MIDIMessage& MIDIMessage::operator= (const MIDIMessage &msg) {
 // Query methods
 //
 
-int MIDIMessage::GetLength() const {
-    if((status & 0xf0) == 0xf0)
-        return sys_msg_len[status - 0xf0];
-    else
-        return chan_msg_len[status >> 4];
-}
-
-
 float MIDIMessage::GetTempo() const {
     return 60.0 * 1.0e6 / GetInternalTempo();
 }
@@ -115,10 +159,7 @@ unsigned long MIDIMessage::GetInternalTempo() const {
 
 
 std::string MIDIMessage::GetText() const {
-    std::string s;
-    for (int i = 0; i < sysex->GetLength(); i++)
-        s += sysex->GetData(i);
-    return s;
+    return std::string((const char *)sysex->GetBuffer(), sysex->GetLength());
 }
 
 //
@@ -334,19 +375,40 @@ void MIDIMessage::SetBeatMarker() {
 //
 
 std::string MIDIMessage::MsgToText (bool chan_from_1) const {
-    char buf[256];
-    std::string txt;
+    char buf[TEXT_BUFFER_SIZE];
+    MsgToText(buf, TEXT_BUFFER_SIZE, chan_from_1);
+    return buf;
+}
+
+
+// Appends formatted text at buf + pos, never writing beyond size; returns the new position.
+static unsigned int AppendText(char* buf, unsigned int size, unsigned int pos, const char* fmt, ...) {
+    if (pos + 1 >= size)
+        return pos;
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf + pos, size - pos, fmt, args);
+    va_end(args);
+    if (n < 0)
+        return pos;
+    return (pos + n < size) ? pos + n : size - 1;
+}
+
+
+unsigned int MIDIMessage::MsgToText(char* buf, unsigned int size, bool chan_from_1) const {
+    if (size == 0)
+        return 0;
+    unsigned int pos = 0;
+    *buf = 0;
 
     // Meta Events
     if (IsMetaEvent()) {
-        sprintf (buf, "%s ", GetSysMsgName(status));
-        txt += buf;
-        txt += GetMetaMsgName(byte1);            // type of meta
+        pos = AppendText(buf, size, pos, "%s %s", GetSysMsgName(status), GetMetaMsgName(byte1));
 
         switch (byte1) {
 
             case META_SEQUENCE_NUMBER:          // 2 byte meta events
-                sprintf (buf, "Data %02X  ", ((int)byte2 >> 8) + byte3);
+                pos = AppendText(buf, size, pos, "Data %02X  ", ((int)byte2 >> 8) + byte3);
                 break;
 
             case META_GENERIC_TEXT:             // text meta events
@@ -363,115 +425,113 @@ std::string MIDIMessage::MsgToText (bool chan_from_1) const {
             case META_GENERIC_TEXT_C:
             case META_GENERIC_TEXT_D:
             case META_GENERIC_TEXT_E:
-            case META_GENERIC_TEXT_F:
-                sprintf(buf, "\"%s\"", GetText().c_str());
-                if (strlen(buf) > 40)
-                    buf[40] = 0;
+            case META_GENERIC_TEXT_F: {
+                // the text between quotes, truncated to 40 characters (quotes included)
+                const char* text = (const char*)sysex->GetBuffer();
+                int len = 0;
+                while (len < sysex->GetLength() && text[len])
+                    len++;
+                if (len + 2 > 40)
+                    pos = AppendText(buf, size, pos, "\"%.*s", 39, text);
+                else
+                    pos = AppendText(buf, size, pos, "\"%.*s\"", len, text);
                 break;
+            }
 
             case META_CHANNEL_PREFIX:       // 1 byte meta events
             case META_OUTPUT_CABLE:
-                sprintf(buf, "Data %2d", byte2);
+                pos = AppendText(buf, size, pos, "Data %2d", byte2);
                 break;
             //META_TRACK_LOOP         = 0x2E, I found no documentation for this
 
             case META_END_OF_TRACK:         // 0 byte meta event
-                *buf = 0;
                 break;
 
             case META_TEMPO:
-                sprintf(buf, "BpM  %3.2f", GetTempo());
+                pos = AppendText(buf, size, pos, "BpM  %3.2f", GetTempo());
                 break;
 
             case META_SMPTE:
-                sprintf(buf, "Data %02d %02d %02d %02d %02d",
-                        sysex->GetData(0), sysex->GetData(1), sysex->GetData(2),
-                        sysex->GetData(3), sysex->GetData(4));
+                pos = AppendText(buf, size, pos, "Data %02d %02d %02d %02d %02d",
+                                 sysex->GetData(0), sysex->GetData(1), sysex->GetData(2),
+                                 sysex->GetData(3), sysex->GetData(4));
                 break;
 
             case META_TIMESIG:
-                sprintf(buf, "Time %d/%d (Other data %02d %02d)",
-                        GetTimeSigNumerator(), GetTimeSigDenominator(),
-                        sysex->GetData(2), sysex->GetData(3));
+                pos = AppendText(buf, size, pos, "Time %d/%d (Other data %02d %02d)",
+                                 GetTimeSigNumerator(), GetTimeSigDenominator(),
+                                 sysex->GetData(2), sysex->GetData(3));
                 break;
 
             case META_KEYSIG:
-                sprintf(buf, "Key %s", KeyName(byte2, byte3));
+                pos = AppendText(buf, size, pos, "Key %s", KeyName(byte2, byte3));
                 break;
 
             default:
-                *buf = 0;
                 break;
         }
-        txt += buf;
     }
 
     // System Exclusive Events
     else if (IsSysEx()) {
-        sprintf (buf, "%s ", GetSysMsgName(status));
-        txt += buf;
-        if (GetSysEx()->IsGMReset())
-            sprintf(buf, "GM Reset");
-        else if (GetSysEx()->IsGSReset())
-            sprintf(buf, "GS Reset");
-        else if (GetSysEx()->IsXGReset())
-            sprintf(buf, "XG Reset");
+        pos = AppendText(buf, size, pos, "%s ", GetSysMsgName(status));
+        if (sysex->IsGMReset())
+            pos = AppendText(buf, size, pos, "GM Reset");
+        else if (sysex->IsGSReset())
+            pos = AppendText(buf, size, pos, "GS Reset");
+        else if (sysex->IsXGReset())
+            pos = AppendText(buf, size, pos, "XG Reset");
         else
-            sprintf (buf, "(length: %d)", GetSysEx()->GetLength());
-        txt += buf;
+            pos = AppendText(buf, size, pos, "(length: %d)", sysex->GetLength());
     }
 
     // Channel Events
     else {
 
-        sprintf (buf, "Ch %2d     ", (int) GetChannel() + chan_from_1);
-        txt += buf;
+        pos = AppendText(buf, size, pos, "Ch %2d     ", (int) GetChannel() + chan_from_1);
 
         if (IsChannelMode()) {
-            sprintf (buf, "%s ", GetChanModeMsgName(GetController()));
-            txt += buf;
+            pos = AppendText(buf, size, pos, "%s ", GetChanModeMsgName(GetController()));
             if (GetType() == C_LOCAL)
-                txt += (byte1 ? " On" : " Off");
+                pos = AppendText(buf, size, pos, (byte1 ? " On" : " Off"));
         }
         else {
-            sprintf (buf, "%s  ", GetChanMsgName(GetType()));
-            txt += buf;
+            pos = AppendText(buf, size, pos, "%s  ", GetChanMsgName(GetType()));
             switch (status & 0xf0) {
                 case NOTE_ON:
                     if (GetVelocity() == 0) // velocity = 0: Note off
-                        sprintf (buf, "Note %3d  Vel  %3d    (Note Off)  ", (int) byte1, (int) byte2);
+                        pos = AppendText(buf, size, pos, "Note %3d  Vel  %3d    (Note Off)  ", (int) byte1, (int) byte2);
                     else
-                        sprintf (buf, "Note %3d  Vel  %3d  ", (int) byte1, (int) byte2);
+                        pos = AppendText(buf, size, pos, "Note %3d  Vel  %3d  ", (int) byte1, (int) byte2);
                     break;
 
                 case NOTE_OFF:
-                    sprintf (buf, "Note %3d  Vel  %3d  ", (int) byte1, (int) byte2 );
+                    pos = AppendText(buf, size, pos, "Note %3d  Vel  %3d  ", (int) byte1, (int) byte2 );
                     break;
 
                 case POLY_PRESSURE:
-                    sprintf (buf, "Note %3d  Pres %3d  ", (int) byte1, (int) byte2 );
+                    pos = AppendText(buf, size, pos, "Note %3d  Pres %3d  ", (int) byte1, (int) byte2 );
                     break;
 
                 case CONTROL_CHANGE:
-                    sprintf (buf, "Ctrl %3d  Val  %3d  ", ( int ) byte1, ( int ) byte2 );
+                    pos = AppendText(buf, size, pos, "Ctrl %3d  Val  %3d  ", ( int ) byte1, ( int ) byte2 );
                     break;
 
                 case PROGRAM_CHANGE:
-                    sprintf (buf, "Prog %3d  ", (int) byte1);
+                    pos = AppendText(buf, size, pos, "Prog %3d  ", (int) byte1);
                     break;
 
                 case CHANNEL_PRESSURE:
-                    sprintf (buf, "Pres %3d  ", (int) byte1 );
+                    pos = AppendText(buf, size, pos, "Pres %3d  ", (int) byte1 );
                     break;
 
                 case PITCH_BEND:
-                    sprintf (buf, "Val %5d  ", (int) GetBenderValue() );
+                    pos = AppendText(buf, size, pos, "Val %5d  ", (int) GetBenderValue() );
                     break;
             }
-            txt += buf;
         }
     }
-    return txt;
+    return pos;
 }
 
 
@@ -497,7 +557,7 @@ bool operator== (const MIDIMessage &m1, const MIDIMessage &m2) {
     if ((m1.sysex == 0 && m2.sysex != 0) ||
         (m1.sysex != 0 && m2.sysex == 0))
         return false;
-    if (m1.sysex == 0 && m2.sysex == 0)
+    if (m1.sysex == m2.sysex)                  // both 0 or shared
         return true;
     return (*m1.sysex == *m2.sysex);
 }
@@ -524,6 +584,17 @@ MIDITimedMessage::MIDITimedMessage(const MIDIMessage &msg)
 {}
 
 
+MIDITimedMessage::MIDITimedMessage(MIDITimedMessage &&msg) noexcept
+    : MIDIMessage(std::move(msg)), time(msg.time) {
+    msg.time = 0;
+}
+
+
+MIDITimedMessage::MIDITimedMessage(MIDIMessage &&msg) noexcept
+    : MIDIMessage(std::move(msg)), time(0)
+{}
+
+
 MIDITimedMessage::~MIDITimedMessage()
 {}
 
@@ -550,18 +621,42 @@ const MIDITimedMessage &MIDITimedMessage::operator= (const MIDIMessage &msg) {
     return *this;
 }
 
+
+const MIDITimedMessage &MIDITimedMessage::operator= (MIDITimedMessage &&msg) noexcept {
+    time = msg.time;
+    if (this != &msg)                           // leave the same state of the move constructor
+        msg.time = 0;
+    MIDIMessage::operator= (std::move(msg));
+    return *this;
+}
+
+
+const MIDITimedMessage &MIDITimedMessage::operator= (MIDIMessage &&msg) noexcept {
+    time = 0;
+    MIDIMessage::operator= (std::move(msg));
+    return *this;
+}
+
 //
 // MsgToText()
 //
 
 std::string MIDITimedMessage::MsgToText(unsigned char chan_from_1) const {
-    char buf[256];
-    std::string txt;
+    char buf[TEXT_BUFFER_SIZE];
+    MsgToText(buf, TEXT_BUFFER_SIZE, chan_from_1);
+    return buf;
+}
+
 
-    sprintf (buf, "%8ld : ", GetTime());
-    txt += buf;
-    txt += MIDIMessage::MsgToText(chan_from_1);
-    return txt;
+unsigned int MIDITimedMessage::MsgToText(char* buf, unsigned int size, unsigned char chan_from_1) const {
+    if (size == 0)
+        return 0;
+    int n = snprintf(buf, size, "%8ld : ", GetTime());
+    if (n < 0)
+        return 0;
+    if ((unsigned int)n >= size)
+        return size - 1;
+    return n + MIDIMessage::MsgToText(buf + n, size - n, chan_from_1 != 0);
 }
 
 
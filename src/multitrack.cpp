@@ -26,6 +26,9 @@
 #include "../include/multitrack.h"
 #include "../include/dump_tracks.h"    // DEBUG:
 #include <iostream>
+#include <utility>
+#include <thread>
+#include <algorithm>
 
 
 ////////////////////////////////////////////////////////////////
@@ -33,6 +36,9 @@
 ////////////////////////////////////////////////////////////////
 
 
+const std::string MIDIMultiTrack::empty_text;
+
+
 MIDIMultiTrack::MIDIMultiTrack(unsigned int num_tracks, unsigned int cl_p_b) :
           clks_per_beat(cl_p_b) {
     tracks.resize(num_tracks);
@@ -71,6 +77,7 @@ void MIDIMultiTrack::Reset(unsigned int num_tracks) {
     for(unsigned int i = 0; i < tracks.size(); i++)
         delete tracks[i];
     tracks.resize(0);
+    ClearTexts();
     for (unsigned int i = 0; i < num_tracks; i++)
         InsertTrack();
 }
@@ -79,6 +86,7 @@ void MIDIMultiTrack::Reset(unsigned int num_tracks) {
 void MIDIMultiTrack::ClearTracks(bool mantain_end) {
     for(unsigned int i = 0; i < tracks.size(); i++)
         tracks[i]->Clear(mantain_end);
+    ClearTexts();
 }
 
 
@@ -160,17 +168,27 @@ void MIDIMultiTrack::AssignEventsToTracks (const MIDITrack *src)
     // tracks 1-16 for channel events, and track 0 for other types of events
     Reset(17);
 
+    // count the events for every track, so they can be allocated at once
+    unsigned int num_events[17] = { 0 };
+    for (unsigned int i = 0; i < tmp.GetNumEvents(); ++i) {
+        const MIDITimedMessage& msg = tmp.GetEvent(i);
+        num_events[msg.IsChannelMsg() ? 1 + msg.GetChannel() : 0]++;
+    }
+    for (unsigned int i = 0; i < 17; ++i)
+        tracks[i]->BeginBulkInsert(num_events[i]);
+
     // move events to tracks 0-16 according their types/channels
     for (unsigned int i = 0; i < tmp.GetNumEvents(); ++i) {
-        const MIDITimedMessage *msg;
-        msg = tmp.GetEventAddress (i);
+        MIDITimedMessage& msg = tmp.GetEvent(i);
 
         int track_num = 0;
-        if (msg->IsChannelMsg())
-            track_num = 1 + msg->GetChannel();
+        if (msg.IsChannelMsg())
+            track_num = 1 + msg.GetChannel();
 
-        tracks[track_num]->PushEvent(*msg);
+        tracks[track_num]->PushEvent(std::move(msg));
     }
+    for (unsigned int i = 0; i < 17; ++i)
+        tracks[i]->EndBulkInsert();
 }
 
 
@@ -226,6 +244,13 @@ bool MIDIMultiTrack::InsertEvent(unsigned int trk_num, const MIDITimedMessage& m
 }
 
 
+bool MIDIMultiTrack::InsertEvent(unsigned int trk_num, MIDITimedMessage&& msg, tInsMode _ins_mode) {
+    if (IsValidTrackNumber(trk_num))
+        return tracks[trk_num]->InsertEvent(std::move(msg), _ins_mode);
+    return false;
+}
+
+
 bool MIDIMultiTrack::InsertNote(unsigned int trk_num, const MIDITimedMessage& msg, MIDIClockTime len, tInsMode _ins_mode) {
     if (IsValidTrackNumber(trk_num))
         return tracks[trk_num]->InsertNote(msg, len, _ins_mode);
@@ -233,6 +258,13 @@ bool MIDIMultiTrack::InsertNote(unsigned int trk_num, const MIDITimedMessage& ms
 }
 
 
+bool MIDIMultiTrack::InsertNote(unsigned int trk_num, MIDITimedMessage&& msg, MIDIClockTime len, tInsMode _ins_mode) {
+    if (IsValidTrackNumber(trk_num))
+        return tracks[trk_num]->InsertNote(std::move(msg), len, _ins_mode);
+    return false;
+}
+
+
 bool MIDIMultiTrack::DeleteEvent(unsigned int trk_num, const MIDITimedMessage& msg) {
     if (IsValidTrackNumber(trk_num))
         return tracks[trk_num]->DeleteEvent(msg);
@@ -247,6 +279,84 @@ bool MIDIMultiTrack::DeleteNote(unsigned int trk_num, const MIDITimedMessage& ms
 }
 
 
+// Compares an interned text with a text buffer, for sorting and looking up text_index.
+static bool TextLess(const std::string* s, const MIDISystemExclusive* text) {
+    return s->compare(0, std::string::npos, (const char*)text->GetBuffer(), text->GetLength()) < 0;
+}
+
+
+void MIDIMultiTrack::InternTexts() {
+    std::lock_guard<std::mutex> lock(texts_mutex);
+    for (unsigned int i = 0; i < tracks.size(); i++) {
+        const MIDITrack* trk = tracks[i];
+        for (unsigned int j = 0; j < trk->GetNumEvents(); j++) {
+            const MIDITimedMessage& msg = trk->GetEvent(j);
+            if (!msg.IsTextEvent() || !msg.GetSysEx() || msg.GetSysEx()->GetLength() == 0)
+                continue;
+            const MIDISystemExclusive* text = msg.GetSysEx();
+            std::vector<const std::string*>::iterator it =
+                std::lower_bound(text_index.begin(), text_index.end(), text, TextLess);
+            if (it != text_index.end() &&
+                (*it)->compare(0, std::string::npos, (const char*)text->GetBuffer(), text->GetLength()) == 0)
+                continue;                           // already interned
+            texts.push_back(std::string((const char*)text->GetBuffer(), text->GetLength()));
+            text_index.insert(it, &texts.back());   // the deque doesn't move its elements
+        }
+    }
+}
+
+
+const std::string* MIDIMultiTrack::FindText(const MIDIMessage& msg) const {
+    if (!msg.IsTextEvent() || !msg.GetSysEx() || msg.GetSysEx()->GetLength() == 0)
+        return &empty_text;
+    const MIDISystemExclusive* text = msg.GetSysEx();
+    std::vector<const std::string*>::const_iterator it =
+        std::lower_bound(text_index.begin(), text_index.end(), text, TextLess);
+    if (it != text_index.end() &&
+        (*it)->compare(0, std::string::npos, (const char*)text->GetBuffer(), text->GetLength()) == 0)
+        return *it;
+    return &empty_text;                             // not interned
+}
+
+
+void MIDIMultiTrack::ClearTexts() {
+    std::lock_guard<std::mutex> lock(texts_mutex);
+    text_index.clear();
+    texts.clear();
+}
+
+
+void MIDIMultiTrack::Transform(const MIDITransform& tr, unsigned int num_threads) {
+    if (num_threads == 0)
+        num_threads = std::thread::hardware_concurrency();
+    if (num_threads > tracks.size())
+        num_threads = tracks.size();
+    std::atomic<unsigned int> next_track(0);
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < num_threads; i++)      // the calling thread is the first worker
+        workers.push_back(std::thread(TransformProc, this, &tr, &next_track));
+    TransformProc(this, &tr, &next_track);
+    for (unsigned int i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+
+void MIDIMultiTrack::TransformProc(MIDIMultiTrack* multi, const MIDITransform* tr,
+                                   std::atomic<unsigned int>* next_track) {
+    unsigned int trk_num;
+    while ((trk_num = next_track->fetch_add(1)) < multi->tracks.size())
+        multi->tracks[trk_num]->Transform(*tr);
+}
+
+
+unsigned int MIDIMultiTrack::Compact(MIDIProcessorCompactor& comp) {
+    unsigned int deleted = 0;
+    for (unsigned int i = 0; i < tracks.size(); i++)
+        deleted += tracks[i]->Compact(comp);
+    return deleted;
+}
+
+
 //TODO: these must be revised
 void MIDIMultiTrack::EditCopy(MIDIClockTime start, MIDIClockTime end,
                                 int tr_start, int tr_end, MIDIEditMultiTrack* edit) {
@@ -269,7 +379,7 @@ void MIDIMultiTrack::EditCopy(MIDIClockTime start, MIDIClockTime end,
 
 
 void MIDIMultiTrack::EditCut(MIDIClockTime start, MIDIClockTime end, MIDIEditMultiTrack* edit) {
-    DumpMIDIMultiTrack(this);
+    //DumpMIDIMultiTrack(this);
 
     if (edit)
         EditCopy(start, end, 0, GetNumTracks()-1, edit);
@@ -292,6 +402,7 @@ void MIDIMultiTrack::EditClear(MIDIClockTime start, MIDIClockTime end, int tr_st
 
 
 void MIDIMultiTrack::EditInsert(MIDIClockTime start, int tr_start, int times, MIDIEditMultiTrack* edit) {
+    if (!edit || times <= 0) return;
 
     MIDIClockTime length = edit->GetEndTime();
     int tr_end = tr_start + edit->GetEndTrack() - edit->GetStartTrack();
@@ -299,16 +410,15 @@ void MIDIMultiTrack::EditInsert(MIDIClockTime start, int tr_start, int times, MI
         tr_end = tracks.size() - 1;
 
     for (unsigned int i = 0; i < tracks.size(); i++)
-        tracks[i]->InsertInterval(start, start + length * times, 0);    // inserts a blank interval
+        tracks[i]->InsertInterval(start, length * times, 0);    // inserts a blank interval
 
     //DumpMIDIMultiTrack(this);
     //DumpMIDIMultiTrack(edit);
 
-    if(edit) {
-        for (int i = tr_start; i <= tr_end; i++) {
-            for(int j = 0; j < times; j++)
-                tracks[i]->ReplaceInterval(start + j * length, length, edit->tracks[i]);
-        }
+    for (int i = tr_start; i <= tr_end; i++) {
+        for(int j = 0; j < times; j++)                          // every copy is a block insertion
+            tracks[i]->ReplaceInterval(start + j * length, start + (j + 1) * length,
+                                       edit->tracks[i - tr_start]);
     }
 
     //DumpMIDIMultiTrack(this);
@@ -318,7 +428,8 @@ void MIDIMultiTrack::EditInsert(MIDIClockTime start, int tr_start, int times, MI
 
 void MIDIMultiTrack::EditReplace(MIDIClockTime start, int tr_start, int times, bool sysex,
                                  MIDIEditMultiTrack* edit) {
-    MIDIClockTime length = edit->tracks[0]->GetEndTime() * times;
+    MIDIClockTime length = edit->tracks[0]->GetEndTime();
+    int edit_start = tr_start;
     int tr_end = tr_start + edit->GetEndTrack() - edit->GetStartTrack();
     if ((unsigned int)tr_end >= tracks.size())
         tr_end = tracks.size() - 1;
@@ -327,17 +438,17 @@ void MIDIMultiTrack::EditReplace(MIDIClockTime start, int tr_start, int times, b
     //DumpMIDIMultiTrack(edit);
 
     for (int i = tr_start; i <= tr_end; i++)
-        tracks[i]->ClearInterval(start, length);        // deletes previous events
+        tracks[i]->ClearInterval(start, start + length * times);    // deletes previous events
 
     if (tr_start == 0)
         tr_start = 1;
         // skip track 0: it will be set from the corresponding INTTrack with a Recompose
-    if (start + times * edit->tracks[0]->GetEndTime() > tracks[0]->GetEndTime())
-        tracks[0]->SetEndTime(start + times * edit->tracks[0]->GetEndTime());
+    if (start + times * length > tracks[0]->GetEndTime())
+        tracks[0]->SetEndTime(start + times * length);
     for (int i = tr_start; i <= tr_end; i++) {
         for(int j = 0; j < times; j++)
-            tracks[i]->ReplaceInterval(start + j * edit->tracks[0]->GetEndTime(),
-                                       edit->tracks[0]->GetEndTime(), edit->tracks[i]);
+            tracks[i]->ReplaceInterval(start + j * length, start + (j + 1) * length,
+                                       edit->tracks[i - edit_start]);
     }
 
     //DumpMIDIMultiTrack(this);
@@ -55,105 +55,105 @@ void MIDISequencerGUINotifierText::Notify(const MIDISequencerGUIEvent &ev) {
     if (sequencer == 0) return;
     if (!en) return;                    // not enabled
 
-    char s[200];
+    char s[200];                        // texts longer than this are truncated
     int trk_num = ev.GetSubGroup();     // used only for track events
-    int wr = sprintf(s, "GUI EVENT: %s ", MIDISequencerGUIEvent::group_names[ev.GetGroup()]);
+    int wr = snprintf(s, sizeof(s) - 1, "GUI EVENT: %s ", MIDISequencerGUIEvent::group_names[ev.GetGroup()]);
 
     switch(ev.GetGroup()) {
         case MIDISequencerGUIEvent::GROUP_ALL:
-            sprintf(s + wr, "GENERAL RESET");
+            snprintf(s + wr, sizeof(s) - 1 - wr, "GENERAL RESET");
             break;
         case MIDISequencerGUIEvent::GROUP_CONDUCTOR:
             switch (ev.GetItem()) {
                 case MIDISequencerGUIEvent::GROUP_CONDUCTOR_TEMPO:
-                    sprintf(s + wr, "TEMPO:    %2f bpm", sequencer->GetState()->tempobpm);
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "TEMPO:    %2f bpm", sequencer->GetState()->tempobpm);
                     break;
                 case MIDISequencerGUIEvent::GROUP_CONDUCTOR_TIMESIG:
-                    sprintf(s + wr, "TIMESIG:  %d/%d", sequencer->GetState()->timesig_numerator,
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "TIMESIG:  %d/%d", sequencer->GetState()->timesig_numerator,
                            sequencer->GetState()->timesig_denominator);
                     break;
                 case MIDISequencerGUIEvent::GROUP_CONDUCTOR_KEYSIG:
-                    sprintf(s + wr, "KEYSIG:   %s", KeyName(sequencer->GetState()->keysig_sharpflat,
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "KEYSIG:   %s", KeyName(sequencer->GetState()->keysig_sharpflat,
                                                        sequencer->GetState()->keysig_mode));
                     break;
                 case MIDISequencerGUIEvent::GROUP_CONDUCTOR_MARKER:
-                    sprintf(s + wr, "MARKER:   %s", sequencer->GetState()->marker_text.c_str());
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "MARKER:   %s", sequencer->GetState()->marker_text->c_str());
                     break;
                 case MIDISequencerGUIEvent::GROUP_CONDUCTOR_USER:
-                    sprintf(s + wr, "USER EV Item %d", ev.GetItem());
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "USER EV Item %d", ev.GetItem());
                     break;
             }
             break;
         case MIDISequencerGUIEvent::GROUP_TRANSPORT:
             switch (ev.GetItem()) {
                 case MIDISequencerGUIEvent::GROUP_TRANSPORT_START:
-                    sprintf(s + wr, "SEQUENCER START");
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "SEQUENCER START");
                     break;
                 case MIDISequencerGUIEvent::GROUP_TRANSPORT_STOP:
-                    sprintf(s + wr, "SEQUENCER STOP");
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "SEQUENCER STOP");
                     break;
                 case MIDISequencerGUIEvent::GROUP_TRANSPORT_MEASURE:
-                    sprintf(s + wr, "MEAS %d", sequencer->GetCurrentMeasure() + start_from);
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "MEAS %d", sequencer->GetCurrentMeasure() + start_from);
                     break;
                 case MIDISequencerGUIEvent::GROUP_TRANSPORT_BEAT:
-                    sprintf(s + wr, "MEAS %d BEAT %d", sequencer->GetCurrentMeasure() + start_from,
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "MEAS %d BEAT %d", sequencer->GetCurrentMeasure() + start_from,
                            sequencer->GetCurrentBeat() + start_from );
                     break;
                 case MIDISequencerGUIEvent::GROUP_TRANSPORT_COUNTIN:
-                    sprintf(s + wr, "SEQUENCER COUNT IN");
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "SEQUENCER COUNT IN");
                     break;
                 case MIDISequencerGUIEvent::GROUP_TRANSPORT_USER:
-                    sprintf(s + wr, "USER EV Item %d", ev.GetItem());
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "USER EV Item %d", ev.GetItem());
                     break;
             }
             break;
         case MIDISequencerGUIEvent::GROUP_TRACK:
-            wr += sprintf (s + wr, "TRACK %3d ", trk_num);
+            wr += snprintf(s + wr, sizeof(s) - 1 - wr, "TRACK %3d ", trk_num);
             switch (ev.GetItem()) {
                 case MIDISequencerGUIEvent::GROUP_TRACK_NAME:
-                    sprintf(s + wr, "NAME: %s", sequencer->GetTrackState(trk_num)->track_name.c_str());
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "NAME: %s", sequencer->GetTrackState(trk_num)->track_name->c_str());
                     break;
                 case MIDISequencerGUIEvent::GROUP_TRACK_PROGRAM:
-                    sprintf(s + wr, "PROGRAM: %d", sequencer->GetTrackState(trk_num)->program);
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "PROGRAM: %d", sequencer->GetTrackState(trk_num)->program);
                     break;
                 case MIDISequencerGUIEvent::GROUP_TRACK_NOTE:
-                    sprintf(s + wr, "NOTE");
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "NOTE");
                     break;
                 case MIDISequencerGUIEvent::GROUP_TRACK_VOLUME:
-                    sprintf(s + wr, "VOLUME: %d",sequencer->GetTrackState(trk_num)->control_values[C_MAIN_VOLUME]);
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "VOLUME: %d",sequencer->GetTrackState(trk_num)->control_values[C_MAIN_VOLUME]);
                     break;
                 case MIDISequencerGUIEvent::GROUP_TRACK_PAN:
-                    sprintf(s + wr, "PAN: %d", sequencer->GetTrackState(trk_num)->control_values[C_PAN]);
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "PAN: %d", sequencer->GetTrackState(trk_num)->control_values[C_PAN]);
                     break;
                 case MIDISequencerGUIEvent::GROUP_TRACK_CHR:
-                    sprintf(s + wr, "CHORUS: %d", sequencer->GetTrackState(trk_num)->control_values[C_CHORUS_DEPTH]);
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "CHORUS: %d", sequencer->GetTrackState(trk_num)->control_values[C_CHORUS_DEPTH]);
                     break;
                 case MIDISequencerGUIEvent::GROUP_TRACK_REV:
-                    sprintf(s + wr, "REVERB: %d", sequencer->GetTrackState(trk_num)->control_values[C_EFFECT_DEPTH]);
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "REVERB: %d", sequencer->GetTrackState(trk_num)->control_values[C_EFFECT_DEPTH]);
                     break;
                 case MIDISequencerGUIEvent::GROUP_TRACK_USER:
-                    sprintf(s + wr, "USER EV Item %d", ev.GetItem());
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "USER EV Item %d", ev.GetItem());
                     break;
             }
             break;
         case MIDISequencerGUIEvent::GROUP_RECORDER:
             switch (ev.GetItem()) {
                 case MIDISequencerGUIEvent::GROUP_RECORDER_RESET:
-                    sprintf(s + wr, "RECORDER RESET");
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "RECORDER RESET");
                     break;
                 case MIDISequencerGUIEvent::GROUP_RECORDER_START:
-                    sprintf(s + wr, "RECORDING START");
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "RECORDING START");
                     break;
                 case MIDISequencerGUIEvent::GROUP_RECORDER_STOP:
-                    sprintf(s + wr, "RECORDING STOP");
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "RECORDING STOP");
                     break;
                 case MIDISequencerGUIEvent::GROUP_RECORDER_USER:
-                    sprintf(s + wr, "USER EV Item %d", ev.GetItem());
+                    snprintf(s + wr, sizeof(s) - 1 - wr, "USER EV Item %d", ev.GetItem());
                     break;
             }
             break;
         case MIDISequencerGUIEvent::GROUP_USER:
-            sprintf(s + wr, "Subgroup: %d Item: %d", ev.GetSubGroup(), ev.GetItem());
+            snprintf(s + wr, sizeof(s) - 1 - wr, "Subgroup: %d Item: %d", ev.GetSubGroup(), ev.GetItem());
             break;
     }
     strcat(s, "\n");
@@ -24,6 +24,10 @@
 
 
 #include "../include/processor.h"
+#include "../include/timer.h"
+
+#include <algorithm>
+#include <cstdlib>
 
 /////////////////////////////////////////////////////////////////
 //                    class MIDIMultiProcessor                 //
@@ -144,11 +148,109 @@ bool MIDIProcessorRechannelizer::Process(MIDITimedMessage *msg) {
 /////////////////////////////////////////////////////////////////
 
 bool MIDIProcessorPrinter::Process(MIDITimedMessage *msg) {
-    if (print_on)
-        ost << msg->MsgToText(chan_from_1) << std::endl;
+    if (print_on) {
+        char buf[MIDIMessage::TEXT_BUFFER_SIZE];
+        msg->MsgToText(buf, MIDIMessage::TEXT_BUFFER_SIZE, chan_from_1);
+        ost << buf << std::endl;
+    }
+    return true;
+}
+
+
+
+/////////////////////////////////////////////////////////////////
+//                 class MIDIProcessorCompactor                //
+/////////////////////////////////////////////////////////////////
+
+MIDIProcessorCompactor::MIDIProcessorCompactor() {
+    Reset();
+}
+
+
+void MIDIProcessorCompactor::Reset() {
+    std::fill(tolerance, tolerance + NUM_KINDS, 0);
+    std::fill(min_spacing, min_spacing + NUM_KINDS, 0);
+    real_time = false;
+    remove_empty_notes = true;
+    ResetValues();
+}
+
+
+void MIDIProcessorCompactor::ResetValues() {
+    std::fill(&last_values[0][0], &last_values[0][0] + 16 * NUM_KINDS, (int)NO_VALUE);
+    std::fill(&last_times[0][0], &last_times[0][0] + 16 * NUM_KINDS, 0);
+    std::fill(last_programs, last_programs + 16, (int)NO_VALUE);
+}
+
+
+void MIDIProcessorCompactor::SetAllTolerances(int tol, unsigned long spacing) {
+    for (int i = 0; i < 128; i++) {
+        tolerance[i] = tol;
+        min_spacing[i] = spacing;
+    }
+}
+
+
+bool MIDIProcessorCompactor::Check(const MIDIMessage& msg, unsigned long time) {
+    if (msg.IsSysEx()) {                        // could reset the device: forget everything
+        ResetValues();
+        return true;
+    }
+    if (!msg.IsChannelMsg())
+        return true;
+
+    int chan = msg.GetChannel();
+    int kind, value;
+    if (msg.IsControlChange()) {
+        kind = msg.GetController();
+        value = msg.GetControllerValue();
+        if (kind == C_GM_BANK || kind == C_GM_BANK + C_LSB) {
+            last_programs[chan] = NO_VALUE;     // the next program change is not a repetition
+            return true;
+        }
+        if (kind == C_DATA_ENTRY || kind == C_DATA_ENTRY + C_LSB ||
+            (kind >= C_DATA_INC && kind <= C_RPN_MSB))
+            return true;                        // meaningful only in sequence: never thinned
+    }
+    else if (msg.IsPitchBend()) {
+        kind = BENDER;
+        value = msg.GetBenderValue();
+    }
+    else if (msg.IsChannelPressure()) {
+        kind = CHAN_PRESSURE;
+        value = msg.GetChannelPressure();
+    }
+    else if (msg.IsProgramChange()) {
+        if (last_programs[chan] == msg.GetProgramValue())
+            return false;
+        last_programs[chan] = msg.GetProgramValue();
+        return true;
+    }
+    else {
+        if (msg.IsChannelMode() && msg.GetController() == C_RESET)
+            std::fill(last_values[chan], last_values[chan] + NUM_KINDS, (int)NO_VALUE);
+        return true;
+    }
+
+    int& last = last_values[chan][kind];
+    if (value == last)
+        return false;
+    bool limit = (kind == BENDER ? value == -8192 || value == 0 || value == 8191 : value == 0 || value == 127);
+    if (last != NO_VALUE && !limit) {
+        if (std::abs(value - last) <= tolerance[kind])
+            return false;
+        if (time >= last_times[chan][kind] && time - last_times[chan][kind] < min_spacing[kind])
+            return false;
+    }
+    last = value;
+    last_times[chan][kind] = time;
     return true;
 }
 
 
+bool MIDIProcessorCompactor::Process(MIDITimedMessage *msg) {
+    return Check(*msg, real_time ? (unsigned long)MIDITimer::GetSysTimeMs() : msg->GetTime());
+}
+
 
 // DONE: implement a MIDIProcessorFilter You can use the rechannelizer
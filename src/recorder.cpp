@@ -32,9 +32,7 @@
 RecNotifier::RecNotifier(MIDISequencer* seq) :
     MIDISequencerGUINotifier(seq),
     meas_note(DEFAULT_MEAS_NOTE), beat_note(DEFAULT_BEAT_NOTE),
-    port(0), chan(9), num_beats(1), other_notifier(0) {
-    on_msg.SetNoteOn(chan, 0, 100);
-    off_msg.SetNoteOn(chan, 0, 0);
+    port(0), chan(9), off_msg(MIDIShortMsg::NoteOn(chan, 0, 0)), num_beats(1), other_notifier(0) {
 }
 
 void RecNotifier::Notify(const MIDISequencerGUIEvent &ev) {
@@ -42,23 +40,17 @@ void RecNotifier::Notify(const MIDISequencerGUIEvent &ev) {
         if (ev.GetGroup() == MIDISequencerGUIEvent::GROUP_TRANSPORT) {
             if (ev.GetItem() == MIDISequencerGUIEvent::GROUP_TRANSPORT_MEASURE) {
                 MIDIManager::GetOutDriver(port)->OutputMessage(off_msg);
-                on_msg.SetNote(meas_note);
-                off_msg.SetNote(meas_note);
-                on_msg.SetChannel(chan);
-                off_msg.SetChannel(chan);
-                MIDIManager::GetOutDriver(port)->OutputMessage(on_msg);
+                off_msg = MIDIShortMsg::NoteOn(chan, meas_note, 0);
+                MIDIManager::GetOutDriver(port)->OutputMessage(MIDIShortMsg::NoteOn(chan, meas_note, 100));
                 num_beats = 0;
                 //std::cout << "Meas" << std::endl;
             }
             else if (ev.GetItem() == MIDISequencerGUIEvent::GROUP_TRANSPORT_BEAT) {
                 if (num_beats != 0) {
                     MIDIManager::GetOutDriver(port)->OutputMessage(off_msg);
-                    on_msg.SetNote(beat_note);
-                    off_msg.SetNote(beat_note);
+                    off_msg = MIDIShortMsg::NoteOn(chan, beat_note, 0);
                     //std::cout << "Beat" << std::endl;
-                    on_msg.SetChannel(chan);
-                    off_msg.SetChannel(chan);
-                    MIDIManager::GetOutDriver(port)->OutputMessage(on_msg);
+                    MIDIManager::GetOutDriver(port)->OutputMessage(MIDIShortMsg::NoteOn(chan, beat_note, 100));
                 }
                 num_beats++;
             }
@@ -57,7 +57,7 @@ void MIDISequencerTrackState::Reset() {
     program = -1;
     for (unsigned int i = 0; i < C_ALL_NOTES_OFF; i++)
         control_values[i] = -1;
-    track_name = "";
+    track_name = &MIDIMultiTrack::empty_text;
     notes_are_on = false;
     bender_value = 0;
     note_matrix.Reset();
@@ -157,7 +157,7 @@ void MIDISequencerState::Reset() {
     timesig_denominator = MIDI_DEFAULT_TIMESIG_DENOMINATOR;
     keysig_sharpflat = MIDI_DEFAULT_KEYSIG_KEY;
     keysig_mode = MIDI_DEFAULT_KEYSIG_MODE;
-    marker_text = "";
+    marker_text = &MIDIMultiTrack::empty_text;
     if (multitrack->GetNumTracks() != track_states.size()) {
         for (unsigned int i = 0; i < track_states.size(); i++)
             delete track_states[i];
@@ -195,6 +195,8 @@ bool MIDISequencerState::Process(MIDITimedMessage *msg) {
         return true;
     }
 
+    uint16_t cat = msg->Classify();             // the message categories
+
     // set new time
     if (msg->GetTime() != cur_clock) {
         cur_clock = msg->GetTime();
@@ -227,12 +229,12 @@ bool MIDISequencerState::Process(MIDITimedMessage *msg) {
     }
 
     // is the event a MIDI channel message?
-    else if(msg->IsChannelMsg()) {
+    else if(cat & MSG_CHANNEL) {
         MIDISequencerTrackState* const t_state = track_states[last_event_track];
-        if( msg->GetType()==PITCH_BEND )        // is it a bender event?
+        if(cat & MSG_PITCH_BEND)                // is it a bender event?
             // yes, remember the bender wheel value
              t_state->bender_value = msg->GetBenderValue();
-        else if( msg->IsControlChange() ) {     // is it a control change event?
+        else if(cat & MSG_CONTROL_CHANGE) {     // is it a control change event?
             // don't monitor system channel messages
             if (msg->GetController() < C_ALL_NOTES_OFF) {
                 t_state->control_values[msg->GetController()] = msg->GetControllerValue();
@@ -247,7 +249,7 @@ bool MIDISequencerState::Process(MIDITimedMessage *msg) {
                     NotifyTrack(MIDISequencerGUIEvent::GROUP_TRACK_REV);
             }
         }
-        else if(msg->IsProgramChange()) {       // is it a program change event?
+        else if(cat & MSG_PROGRAM_CHANGE) {     // is it a program change event?
             // yes, update the current program change value
             t_state->program = msg->GetProgramValue();
             NotifyTrack(MIDISequencerGUIEvent::GROUP_TRACK_PROGRAM);
@@ -268,7 +270,7 @@ bool MIDISequencerState::Process(MIDITimedMessage *msg) {
     }
 
     // is the event a meta-event?
-    else if(msg->IsMetaEvent()) {
+    else if(cat & MSG_META) {
         MIDISequencerTrackState* const t_state = track_states[last_event_track];    // needed in META TRACK NAME
         if(msg->IsTempo()) {                    // is it a tempo event?
             tempobpm = msg->GetTempo();
@@ -315,17 +317,16 @@ bool MIDISequencerState::Process(MIDITimedMessage *msg) {
                    MIDISequencerGUIEvent::GROUP_CONDUCTOR_KEYSIG);
         }
         else if ( msg->IsMarkerText()) {        // is it a marker event?
-            marker_text = std::string((const char *)msg->GetSysEx()->GetBuffer(), msg->GetSysEx()->GetLength());
+            marker_text = multitrack->FindText(*msg);
             Notify(MIDISequencerGUIEvent::GROUP_CONDUCTOR,
                    MIDISequencerGUIEvent::GROUP_CONDUCTOR_MARKER);
         }
         else if( ( msg->GetMetaType()==META_TRACK_NAME
                  || msg->GetMetaType()==META_INSTRUMENT_NAME
                  || (!t_state->got_good_track_name && msg->GetMetaType()==META_GENERIC_TEXT && msg->GetTime()==0) )
-                 && msg->GetSysEx() ) {           // is it a track name event?
+                 && msg->GetSysEx() != 0) {  // is it a track name event?
             t_state->got_good_track_name = true;
-            int len = msg->GetSysEx()->GetLength();
-            t_state->track_name = std::string((const char *)msg->GetSysEx()->GetBuffer(), len);
+            t_state->track_name = multitrack->FindText(*msg);
             NotifyTrack(MIDISequencerGUIEvent::GROUP_TRACK_NAME);
         }
         return true;
@@ -379,6 +380,7 @@ MIDISequencer::MIDISequencer (MIDIMultiTrack *m, MIDISequencerGUINotifier *n) :
     if (n)
         n->SetSequencer(this);
     beat_marker_msg.SetBeatMarker();
+    m->InternTexts();
 }
 
 
@@ -395,6 +397,7 @@ void MIDISequencer::Reset() {
     time_shift_mode = false;
     state.iterator.SetTimeShiftMode(false);         // before state.Reset() which uses GetShiftedTime()
     state.Reset();                                  // syncronizes the multitrack with the state and goes to zero
+    state.multitrack->InternTexts();                // the texts are only looked up during the playback
     for (unsigned int i = 0; i < track_processors.size(); ++i)
         if (track_processors[i])
             delete track_processors[i];
@@ -614,6 +617,13 @@ bool MIDISequencer::MoveTrack(int from, int to) {
 }
 
 
+void MIDISequencer::UpdateStatus() {
+    std::lock_guard<std::recursive_mutex> lock(proc_lock);
+    state.multitrack->InternTexts();                // texts of the new events
+    GoToTime(state.cur_clock);
+}
+
+
 void MIDISequencer::GoToZero() {
     // temporarily disable the gui notifier
     bool notifier_mode = false;
@@ -1359,8 +1369,9 @@ void MIDISequencer::TickProc(tMsecs sys_time) {
                 break;
             }
             else if (!msg.IsMetaEvent() && !msg.IsBeatMarker())
-                // otherwise tell the driver to send this message now
-                MIDIManager::GetOutDriver(GetTrackOutPort(msg_track))->OutputMessage(msg);
+                // otherwise tell the driver to send this message (giving it the exact system time)
+                MIDIManager::GetOutDriver(GetTrackOutPort(msg_track))->OutputTimedMessage
+                    (msg, (double)next_event_time - dev_time_offset + sys_time_offset);
         }
     }
     // auto stop at end of sequence
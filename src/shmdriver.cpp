@@ -0,0 +1,378 @@
+/*
+ *   NiCMidi - A C++ Class Library for MIDI
+ *
+ *   Copyright (C) 2021, 2022  Nicola Cassetta
+ *   https://github.com/ncassetta/NiCMidi
+ *
+ *   This file is part of NiCMidi.
+ *
+ *   NiCMidi is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   NiCMidi is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with NiCMidi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "../include/shmdriver.h"
+
+#ifndef WIN32
+
+#include <cstring>
+#include <climits>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+    #include <time.h>
+#endif // __linux__
+
+
+/////////////////////////////////////////////////
+//             class MIDIShmRing               //
+/////////////////////////////////////////////////
+
+
+MIDIShmRing::MIDIShmRing(const std::string& nm, unsigned int n) :
+    name(nm), num_records(n), map_size(sizeof(Header) + n * sizeof(Record)),
+    header(0), records(0), read_count(0) {
+}
+
+
+MIDIShmRing::~MIDIShmRing() {
+    Close();
+}
+
+
+bool MIDIShmRing::Open() {
+    if (IsOpen())
+        return true;
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0666);
+    if (fd == -1) {
+        std::cerr << "MIDIShmRing: cannot open shared memory " << name << std::endl;
+        return false;
+    }
+    // a new object is zero filled, and this is a valid empty ring; an existing one must never be
+    // resized, because other processes have it mapped (they would get SIGBUS)
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (st.st_size == 0 && (ftruncate(fd, map_size) == -1 || fstat(fd, &st) == -1))) {
+        std::cerr << "MIDIShmRing: cannot resize shared memory " << name << std::endl;
+        close(fd);
+        return false;
+    }
+    if ((size_t)st.st_size != map_size) {
+        std::cerr << "MIDIShmRing: shared memory " << name << " has a different size" << std::endl;
+        close(fd);
+        return false;
+    }
+    void* p = mmap(0, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        std::cerr << "MIDIShmRing: cannot map shared memory " << name << std::endl;
+        return false;
+    }
+    Header* h = static_cast<Header*>(p);
+    uint32_t n = 0;
+    if (!h->num_records.compare_exchange_strong(n, num_records) && n != num_records) {
+        std::cerr << "MIDIShmRing: shared memory " << name << " has a different size" << std::endl;
+        munmap(p, map_size);
+        return false;
+    }
+    header = h;
+    records = reinterpret_cast<Record*>(h + 1);
+    Sync();
+    return true;
+}
+
+
+void MIDIShmRing::Close() {
+    if (IsOpen()) {
+        munmap(header, map_size);
+        header = 0;
+        records = 0;
+    }
+}
+
+
+void MIDIShmRing::Unlink() {
+    shm_unlink(name.c_str());
+}
+
+
+bool MIDIShmRing::Write(const unsigned char* data, unsigned int len) {
+    unsigned int num_used = (len + RECORD_LENGTH - 1) / RECORD_LENGTH;
+    if (!IsOpen() || len == 0 || num_used > num_records)
+        return false;
+    uint64_t count = header->write_count.load(std::memory_order_relaxed);
+    for (unsigned int i = 0; i < num_used; i++, count++) {
+        unsigned int rec_len = (i < num_used - 1 ? RECORD_LENGTH : len - i * RECORD_LENGTH);
+        Record& rec = records[count % num_records];
+        rec.rec_seq.store(2 * count + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        rec.len = rec_len | (i > 0 ? CONTINUED : 0) | (i < num_used - 1 ? MORE : 0);
+        memcpy(rec.data, data + i * RECORD_LENGTH, rec_len);
+        rec.rec_seq.store(2 * count + 2, std::memory_order_release);
+    }
+    // the readers see all the records of the message together
+    header->write_count.store(count, std::memory_order_release);
+    // wake_seq and waiters are written by a side and read by the other in opposite order, so they
+    // need seq_cst (otherwise the reader could sleep after the writer has seen no waiters)
+    header->wake_seq.fetch_add(1, std::memory_order_seq_cst);
+#ifdef __linux__
+    if (header->waiters.load(std::memory_order_seq_cst) > 0)
+        syscall(SYS_futex, &header->wake_seq, FUTEX_WAKE, INT_MAX, 0, 0, 0);
+#endif // __linux__
+    return true;
+}
+
+
+void MIDIShmRing::Sync() {
+    if (IsOpen())
+        read_count = header->write_count.load(std::memory_order_acquire);
+}
+
+
+unsigned int MIDIShmRing::Read(std::vector<unsigned char>& data) {
+    data.clear();
+    if (!IsOpen())
+        return 0;
+    for (;;) {
+        uint64_t count = header->write_count.load(std::memory_order_acquire);
+        if (read_count == count) {
+            data.clear();
+            return 0;
+        }
+        if (count - read_count > num_records) {     // the writer has overwritten older messages
+            read_count = count - num_records;
+            data.clear();
+        }
+        const Record& rec = records[read_count % num_records];
+        uint64_t seq = rec.rec_seq.load(std::memory_order_acquire);
+        unsigned int flags = rec.len;
+        unsigned int len = flags & LEN_MASK;
+        if (len > RECORD_LENGTH)
+            len = RECORD_LENGTH;
+        unsigned int old_size = data.size();
+        data.resize(old_size + len);
+        memcpy(data.data() + old_size, rec.data, len);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        read_count++;
+        if (seq != 2 * read_count || rec.rec_seq.load(std::memory_order_relaxed) != seq) {
+            data.clear();                           // overwritten while we were reading: skip the message
+            continue;
+        }
+        if ((flags & CONTINUED) && old_size == 0) {
+            data.clear();                           // the start of the message was lost
+            continue;
+        }
+        if (!(flags & MORE))
+            return data.size();
+    }
+}
+
+
+bool MIDIShmRing::Wait(unsigned int timeout_ms) {
+    if (!IsOpen())
+        return false;
+    uint32_t seq = header->wake_seq.load(std::memory_order_seq_cst);
+    if (header->write_count.load(std::memory_order_acquire) != read_count)
+        return true;
+#ifdef __linux__
+    timespec ts;
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    header->waiters.fetch_add(1, std::memory_order_seq_cst);
+    // returns immediately if the writer has incremented wake_seq after we read it
+    syscall(SYS_futex, &header->wake_seq, FUTEX_WAIT, seq, &ts, 0, 0);
+    header->waiters.fetch_sub(1, std::memory_order_seq_cst);
+#else
+    for (unsigned int i = 0; i < timeout_ms; i++) {
+        if (header->wake_seq.load(std::memory_order_acquire) != seq)
+            break;
+        MIDITimer::Wait(1);
+    }
+#endif // __linux__
+    return header->write_count.load(std::memory_order_acquire) != read_count;
+}
+
+
+/////////////////////////////////////////////////
+//           class MIDIShmOutDriver            //
+/////////////////////////////////////////////////
+
+
+MIDIShmOutDriver::MIDIShmOutDriver(int id, const std::string& shm_name, unsigned int num_records) :
+    MIDIOutDriver(id, RtMidi::RTMIDI_DUMMY), ring(shm_name, num_records) {
+}
+
+
+MIDIShmOutDriver::~MIDIShmOutDriver() {
+    ring.Close();
+}
+
+
+void MIDIShmOutDriver::Reset() {
+    ring.Close();
+    processor = 0;
+    num_open = 0;
+}
+
+
+void MIDIShmOutDriver::OpenPort() {
+    if (num_open == 0) {
+        if (!ring.Open())
+            return;
+        out_notes.Reset();
+        ResetShadow();
+    }
+    num_open++;
+
+    std::cout << "OUT Port " << GetPortName() << " open";
+    if (num_open > 1)
+        std::cout << " (" << num_open << " times)";
+    std::cout<< std::endl;
+}
+
+
+void MIDIShmOutDriver::ClosePort() {
+    if (num_open == 1)
+        ring.Close();
+    if (num_open > 0) {
+        num_open--;
+        std::cout << "OUT Port " << GetPortName() << " closed";
+        if (num_open > 0)
+            std::cout << " (open " << num_open << " times)";
+        std::cout << std::endl;
+    }
+    else
+        std::cout << "OUT Port " << GetPortName()
+        << "Attempt to close an already closed port!" << std::endl;
+}
+
+
+void MIDIShmOutDriver::HardwareMsgOut(const MIDIMessage &msg) {
+    if (!ring.IsOpen())
+        return;
+    TrackNotes(msg);
+
+    if (msg.IsSysEx()) {            // long sysex are split over more records by the ring
+        if (!ring.Write(msg.GetSysEx()->GetBuffer(), msg.GetSysEx()->GetLength()))
+            std::cerr << "MIDIShmOutDriver: sysex too long (" << msg.GetSysEx()->GetLength()
+                      << " bytes) for the ring, skipped" << std::endl;
+    }
+
+    else if (msg.IsMetaEvent())
+        return;                     // don't send meta events
+
+    else {                          // other messages
+        unsigned char bytes[3];
+        unsigned int len = 0;
+        bytes[len++] = msg.GetStatus();
+        if (msg.GetLength() > 1)
+            bytes[len++] = msg.GetByte1();
+        if (msg.GetLength() > 2)
+            bytes[len++] = msg.GetByte2();
+        ring.Write(bytes, len);
+    }
+}
+
+
+/////////////////////////////////////////////////
+//           class MIDIShmInDriver             //
+/////////////////////////////////////////////////
+
+
+MIDIShmInDriver::MIDIShmInDriver(int id, const std::string& shm_name, unsigned int num_records,
+                                 unsigned int queue_size) :
+    MIDIInDriver(id, RtMidi::RTMIDI_DUMMY, queue_size), ring(shm_name, num_records), reading(false) {
+}
+
+
+MIDIShmInDriver::~MIDIShmInDriver() {
+    StopReading();
+}
+
+
+void MIDIShmInDriver::Reset() {
+    StopReading();
+    num_open = 0;
+    in_queue.Reset();
+
+    processor = 0;
+}
+
+
+void MIDIShmInDriver::OpenPort() {
+    if (num_open == 0) {
+        if (!ring.Open())
+            return;
+        reading.store(true);
+        read_thread = std::thread(ReadProc, this);
+    }
+    num_open++;
+
+    std::cout << "IN Port " << GetPortName() << " open";
+    if (num_open > 1)
+        std::cout << " (" << num_open << " times)";
+    std::cout<< std::endl;
+}
+
+
+void MIDIShmInDriver::ClosePort() {
+    if (num_open == 1)
+        StopReading();
+    if (num_open > 0) {
+        num_open--;
+
+        std::cout << "IN Port " << GetPortName() << " closed";
+        if (num_open > 0)
+            std::cout << " (" << num_open << " times)";
+        std::cout << std::endl;
+    }
+    else
+        std::cout << "IN Port " << GetPortName()
+        << "Attempt to close an already closed port!" << std::endl;
+}
+
+
+void MIDIShmInDriver::StopReading() {
+    reading.store(false);
+    if (read_thread.joinable())
+        read_thread.join();
+    ring.Close();
+}
+
+
+void MIDIShmInDriver::ReadProc(MIDIShmInDriver* drv) {
+    std::vector<unsigned char> bytes;
+    bytes.reserve(4 * MIDIShmRing::RECORD_LENGTH);
+    while (drv->reading.load()) {
+        if (!drv->ring.Wait(100))                   // wakes periodically to check the reading flag
+            continue;
+        unsigned int len;
+        while ((len = drv->ring.Read(bytes)) > 0) {
+            MIDITimedMessage msg;
+            if (!DecodeMessage(bytes.data(), len, msg))
+                continue;
+
+            drv->in_mutex.lock();
+            if (drv->processor)
+                drv->processor->Process(&msg);
+            drv->in_queue.PutMessage(MIDIRawMessage(msg, MIDITimer::GetSysTimeMs(), drv->port_id));
+            drv->in_mutex.unlock();
+        }
+    }
+}
+
+#endif // WIN32
@@ -0,0 +1,164 @@
+/*
+ *   NiCMidi - A C++ Class Library for MIDI
+ *
+ *   Copyright (C) 2021, 2022  Nicola Cassetta
+ *   https://github.com/ncassetta/NiCMidi
+ *
+ *   This file is part of NiCMidi.
+ *
+ *   NiCMidi is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   NiCMidi is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with NiCMidi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "../include/snapshot.h"
+
+
+/////////////////////////////////////////////////
+//             class MIDISnapshot              //
+/////////////////////////////////////////////////
+
+
+bool MIDISnapshot::Update(const MIDITrack* trk) {
+    if (IsUpToDate(&trk, 1))
+        return false;
+    Build(&trk, 1);
+    return true;
+}
+
+
+bool MIDISnapshot::Update(const MIDIMultiTrack* multi) {
+    std::vector<const MIDITrack*> trks(multi->GetNumTracks());
+    for (unsigned int i = 0; i < trks.size(); i++)
+        trks[i] = multi->GetTrack(i);
+    if (IsUpToDate(trks.data(), trks.size()))
+        return false;
+    Build(trks.data(), trks.size());
+    return true;
+}
+
+
+void MIDISnapshot::Clear() {
+    times.clear();
+    statuses.clear();
+    bytes1.clear();
+    bytes2.clear();
+    track_nums.clear();
+    sources.clear();
+    edit_gens.clear();
+}
+
+
+unsigned int MIDISnapshot::Count(unsigned char status, unsigned char mask) const {
+    const unsigned char* st = statuses.data();
+    unsigned int n = statuses.size(), count = 0;
+    status &= mask;
+    for (unsigned int i = 0; i < n; i++)        // no branches: this is vectorized
+        count += (st[i] & mask) == status;
+    return count;
+}
+
+
+unsigned int MIDISnapshot::Filter(unsigned char status, unsigned char mask,
+                                  std::vector<unsigned int>& ev_nums) const {
+    return Filter(status, mask, ev_nums, false);
+}
+
+
+bool MIDISnapshot::GetRange(unsigned char status, unsigned char mask, int byte,
+                            unsigned char& min, unsigned char& max) const {
+    const unsigned char* st = statuses.data();
+    const unsigned char* data = (byte == 2 ? bytes2.data() : bytes1.data());
+    unsigned int n = statuses.size();
+    unsigned char lo = 0xff, hi = 0, found = 0;
+    status &= mask;
+    for (unsigned int i = 0; i < n; i++) {      // the non selected events are masked with neutral values
+        unsigned char sel = -((st[i] & mask) == status);    // 0xff if selected, 0 otherwise
+        unsigned char v_lo = data[i] | ~sel;
+        unsigned char v_hi = data[i] & sel;
+        lo = v_lo < lo ? v_lo : lo;
+        hi = v_hi > hi ? v_hi : hi;
+        found |= sel;
+    }
+    if (!found)
+        return false;
+    min = lo;
+    max = hi;
+    return true;
+}
+
+
+void MIDISnapshot::Histogram(unsigned char status, unsigned char mask, int byte,
+                             unsigned int hist[128]) const {
+    const unsigned char* st = statuses.data();
+    const unsigned char* data = (byte == 2 ? bytes2.data() : bytes1.data());
+    unsigned int n = statuses.size();
+    status &= mask;
+    for (unsigned int i = 0; i < n; i++)
+        hist[data[i] & 0x7f] += (st[i] & mask) == status;
+}
+
+
+unsigned int MIDISnapshot::Filter(unsigned char status, unsigned char mask,
+                                  std::vector<unsigned int>& ev_nums, bool chan_only) const {
+    const unsigned char* st = statuses.data();
+    unsigned int n = statuses.size();
+    ev_nums.resize(n);                          // writes every index, advancing only on the selected ones
+    unsigned int* out = ev_nums.data();
+    unsigned int count = 0;
+    status &= mask;
+    for (unsigned int i = 0; i < n; i++) {
+        out[count] = i;
+        count += (st[i] & mask) == status && (!chan_only || (st[i] >= 0x80 && st[i] < 0xf0));
+    }
+    ev_nums.resize(count);
+    return count;
+}
+
+
+bool MIDISnapshot::IsUpToDate(const MIDITrack* const* trks, unsigned int num_trks) const {
+    if (sources.size() != num_trks)
+        return false;
+    for (unsigned int i = 0; i < num_trks; i++)
+        if (sources[i] != trks[i] || edit_gens[i] != trks[i]->GetEditGeneration())
+            return false;
+    return true;
+}
+
+
+void MIDISnapshot::Build(const MIDITrack* const* trks, unsigned int num_trks) {
+    Clear();
+    unsigned int num_events = 0;
+    for (unsigned int i = 0; i < num_trks; i++)
+        num_events += trks[i]->GetNumEvents() - 1;
+    times.resize(num_events);
+    statuses.resize(num_events);
+    bytes1.resize(num_events);
+    bytes2.resize(num_events);
+    track_nums.resize(num_events);
+
+    unsigned int j = 0;
+    for (unsigned int i = 0; i < num_trks; i++) {
+        const MIDITrack* trk = trks[i];
+        for (unsigned int ev_num = 0; ev_num < trk->GetNumEvents() - 1; ev_num++, j++) {
+            const MIDITimedMessage& msg = trk->GetEvent(ev_num);    // DATA_END is not copied
+            times[j] = msg.GetTime();
+            statuses[j] = msg.GetStatus();
+            bytes1[j] = msg.GetByte1();
+            bytes2[j] = msg.GetByte2();
+            track_nums[j] = i;
+        }
+        sources.push_back(trk);
+        edit_gens.push_back(trk->GetEditGeneration());
+    }
+}
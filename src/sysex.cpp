@@ -29,36 +29,62 @@
 #include <iostream>     // for debug
 
 
-const unsigned char MIDISystemExclusive::GMReset_data[] = { 0xF0, 0x7E, 0x7F, 0x09, 0x01, 0xF7 };
-const unsigned char MIDISystemExclusive::GSReset_data[] = { 0xF0, 0x41, 0x10, 0x42, 0x12, 0x40, 0x00, 0x7F, 0x00, 0x41, 0xF7 };
-const unsigned char MIDISystemExclusive::XGReset_data[] = { 0xF0, 0x43, 0x10, 0x4C, 0x00, 0x00, 0x7E, 0x00, 0xF7 };
+constexpr unsigned char MIDISystemExclusive::GMReset_data[];
+constexpr unsigned char MIDISystemExclusive::GSReset_data[];
+constexpr unsigned char MIDISystemExclusive::XGReset_data[];
 
+thread_local MIDISystemExclusive::PoolCache MIDISystemExclusive::pool_cache = { 0, 0, false };
+MIDISystemExclusive::PoolBlock* MIDISystemExclusive::pool_batches = 0;
+unsigned int MIDISystemExclusive::pool_num_free = 0;
+std::vector<void*> MIDISystemExclusive::pool_chunks;
+std::mutex MIDISystemExclusive::pool_mutex;
 
-MIDISystemExclusive::MIDISystemExclusive(unsigned int len) : chk_sum(0) {
-    if (len != 0)
-        buffer.reserve(len);
+
+MIDISystemExclusive::MIDISystemExclusive(unsigned int len) :
+    buffer(inline_buf), length(0), capacity(INLINE_SIZE), chk_sum(0), ref_count(1) {
+    if (len > INLINE_SIZE)
+        Grow(len);
+}
+
+
+MIDISystemExclusive::MIDISystemExclusive(const MIDISystemExclusive &se) :
+    buffer(inline_buf), length(0), capacity(INLINE_SIZE), chk_sum(se.chk_sum), ref_count(1) {
+    if (se.length > INLINE_SIZE)
+        Grow(se.length);
+    memcpy(buffer, se.buffer, se.length);
+    length = se.length;
 }
 
 
-MIDISystemExclusive::MIDISystemExclusive(const MIDISystemExclusive &se) : buffer(se.buffer), chk_sum(se.chk_sum) {
+MIDISystemExclusive::MIDISystemExclusive(const unsigned char *buf, unsigned int len) :
+    buffer(inline_buf), length(0), capacity(INLINE_SIZE), chk_sum(0), ref_count(1) {
+    if (len > INLINE_SIZE)
+        Grow(len);
+    memcpy(buffer, buf, len);
+    length = len;
 }
 
 
-MIDISystemExclusive::MIDISystemExclusive(const unsigned char *buf, unsigned int len) : chk_sum(0) {
-    for (unsigned int i = 0; i < len; i++)
-        buffer.push_back(buf[i]);
+MIDISystemExclusive::~MIDISystemExclusive() {
+    if (buffer != inline_buf)
+        delete[] buffer;
 }
 
 
 MIDISystemExclusive& MIDISystemExclusive::operator= (const MIDISystemExclusive& se) {
-    chk_sum = se.chk_sum;
-    buffer = se.buffer;
+    if (this != &se) {
+        if (se.length > capacity)
+            Grow(se.length);
+        memcpy(buffer, se.buffer, se.length);
+        length = se.length;
+        chk_sum = se.chk_sum;
+    }
     return *this;
 }
 
 
 bool MIDISystemExclusive::operator== (const MIDISystemExclusive &se) const {
-    if (buffer != se.buffer)
+    if (length != se.length || memcmp(buffer, se.buffer, length) != 0)
         return false;
     if (chk_sum != se.chk_sum)
         return false;
@@ -67,15 +93,142 @@ bool MIDISystemExclusive::operator== (const MIDISystemExclusive &se) const {
 
 
 bool MIDISystemExclusive::IsGMReset() const {
-    return memcmp(buffer.data(), GMReset_data, buffer.size()) == 0 ;
+    return length == GMReset_len && memcmp(buffer, GMReset_data, length) == 0;
 }
 
 
 bool MIDISystemExclusive::IsGSReset() const {
-    return memcmp(buffer.data(), GSReset_data, buffer.size()) == 0;
+    return length == GSReset_len && memcmp(buffer, GSReset_data, length) == 0;
 }
 
 
 bool MIDISystemExclusive::IsXGReset() const {
-    return memcmp(buffer.data(), XGReset_data, buffer.size()) == 0;
+    return length == XGReset_len && memcmp(buffer, XGReset_data, length) == 0;
+}
+
+
+void MIDISystemExclusive::Grow(unsigned int new_cap) {
+    if (new_cap <= capacity)
+        return;
+    if (new_cap < 2 * capacity)
+        new_cap = 2 * capacity;                 // amortized growth as std::vector
+    unsigned char* new_buf = new unsigned char[new_cap];
+    memcpy(new_buf, buffer, length);
+    if (buffer != inline_buf)
+        delete[] buffer;
+    buffer = new_buf;
+    capacity = new_cap;
+}
+
+
+void* MIDISystemExclusive::operator new(size_t size) {
+    if (size != sizeof(MIDISystemExclusive))
+        return ::operator new(size);
+    PoolCache& cache = pool_cache;
+    if (cache.closed) {                         // the thread is ending: take a block from the shared pool
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if (pool_batches == 0)
+            EnlargePool();
+        PoolBlock* block = pool_batches;
+        if (--block->batch_len > 0) {           // the second block becomes the first of the batch
+            block->next->next_batch = block->next_batch;
+            block->next->batch_len = block->batch_len;
+            pool_batches = block->next;
+        }
+        else
+            pool_batches = block->next_batch;
+        pool_num_free--;
+        return block;
+    }
+    if (cache.free == 0)
+        RefillCache(cache);
+    PoolBlock* block = cache.free;
+    cache.free = block->next;
+    cache.num_free--;
+    return block;
+}
+
+
+void MIDISystemExclusive::operator delete(void* p, size_t size) {
+    if (p == 0)
+        return;
+    if (size != sizeof(MIDISystemExclusive)) {
+        ::operator delete(p);
+        return;
+    }
+    PoolBlock* block = static_cast<PoolBlock*>(p);
+    PoolCache& cache = pool_cache;
+    if (cache.closed) {                         // the thread is ending: give the block to the shared pool
+        block->next = 0;
+        ReleaseBatch(block, 1);
+        return;
+    }
+    block->next = cache.free;
+    cache.free = block;
+    cache.num_free++;
+    if (cache.num_free >= 2 * POOL_BATCH) {     // too many free blocks: give back a batch
+        PoolBlock* last = cache.free;
+        for (unsigned int i = 1; i < POOL_BATCH; i++)
+            last = last->next;
+        PoolBlock* first = cache.free;
+        cache.free = last->next;
+        cache.num_free -= POOL_BATCH;
+        last->next = 0;
+        ReleaseBatch(first, POOL_BATCH);
+    }
+}
+
+
+unsigned int MIDISystemExclusive::GetPoolFree() {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    return pool_num_free + pool_cache.num_free;
+}
+
+
+MIDISystemExclusive::PoolCache::~PoolCache() {
+    if (free)
+        ReleaseBatch(free, num_free);
+    free = 0;
+    num_free = 0;
+    closed = true;                              // objects deleted after this go to the shared pool
+}
+
+
+void MIDISystemExclusive::RefillCache(PoolCache& cache) {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if (pool_batches == 0)
+        EnlargePool();
+    PoolBlock* batch = pool_batches;
+    pool_batches = batch->next_batch;
+    pool_num_free -= batch->batch_len;
+    cache.free = batch;
+    cache.num_free = batch->batch_len;
+}
+
+
+void MIDISystemExclusive::EnlargePool() {
+    static_assert(sizeof(PoolBlock) <= sizeof(MIDISystemExclusive), "pool blocks larger than the objects");
+    char* chunk = static_cast<char*>(::operator new(POOL_CHUNK * sizeof(MIDISystemExclusive)));
+    pool_chunks.push_back(chunk);
+    // splits the chunk into batches of POOL_BATCH blocks (the pool is empty)
+    for (unsigned int i = POOL_CHUNK; i > 0; i--) {
+        PoolBlock* block = reinterpret_cast<PoolBlock*>(chunk + (i - 1) * sizeof(MIDISystemExclusive));
+        block->next = (i % POOL_BATCH == 0 ? 0 : pool_batches);
+        if ((i - 1) % POOL_BATCH == 0) {        // the first block of a batch
+            block->next_batch = (i - 1 + POOL_BATCH == POOL_CHUNK ? 0 :
+                reinterpret_cast<PoolBlock*>(chunk + (i - 1 + POOL_BATCH) * sizeof(MIDISystemExclusive)));
+            block->batch_len = POOL_BATCH;
+        }
+        pool_batches = block;
+    }
+    pool_num_free += POOL_CHUNK;
+}
+
+
+void MIDISystemExclusive::ReleaseBatch(PoolBlock* first, unsigned int len) {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    first->next_batch = pool_batches;
+    first->batch_len = len;
+    pool_batches = first;
+    pool_num_free += len;
 }
@@ -36,6 +36,7 @@ unsigned int MIDITimer::resolution = MIDITimer::DEFAULT_RESOLUTION;
 void* MIDITimer::tick_param = 0;
 MIDITick* MIDITimer::tick_proc = 0;
 std::atomic<int> MIDITimer::num_open(0);
+std::atomic<bool> MIDITimer::external_clock(false);
 MIDITimer::timepoint MIDITimer::current;
 std::thread MIDITimer::bg_thread;
 
@@ -81,7 +82,7 @@ bool MIDITimer::Start () {
         return false;                           // Callback not set
 
     num_open++;
-    if (num_open == 1) {                         // Must create thread
+    if (num_open == 1 && !external_clock) {      // Must create thread
         current = std::chrono::steady_clock::now();
         bg_thread = std::thread(ThreadProc);
         std::cout << "Timer open with " << resolution << " msecs resolution" << std::endl;
@@ -93,7 +94,7 @@ bool MIDITimer::Start () {
 void MIDITimer::Stop() {
     if (num_open > 0) {
         num_open--;
-        if (num_open == 0) {
+        if (num_open == 0 && bg_thread.joinable()) {
             bg_thread.join();
 
             std:: cout << "Timer stopped by MIDITimer::Stop()" << std::endl;
@@ -105,11 +106,29 @@ void MIDITimer::Stop() {
 void MIDITimer::HardStop() {
     if (num_open > 0) {
         num_open = 0;
-        bg_thread.join();
+        if (bg_thread.joinable())
+            bg_thread.join();
         std:: cout << "Timer stopped by MIDITimer::HardStop()" << std::endl;
     }
 }
 
+
+void MIDITimer::SetExternalClock(bool on) {
+    int was_open = num_open;
+    HardStop();
+    external_clock = on;
+    if (was_open > 0) {
+        Start();
+        num_open = was_open;
+    }
+}
+
+
+void MIDITimer::ExternalTick(tMsecs sys_time) {
+    if (external_clock && num_open > 0)
+        tick_proc(sys_time, tick_param);
+}
+
     // This is the background thread procedure
 void MIDITimer::ThreadProc() {
     duration tick(resolution);
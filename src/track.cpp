@@ -27,6 +27,9 @@
 
 #include "../include/track.h"
 #include "../include/matrix.h"
+#include <utility>              // for std::move()
+#include <algorithm>            // for std::stable_sort(), std::inplace_merge(), std::is_sorted(), std::fill(),
+                                // std::copy(), std::max()
 
 
 ////////////////////////////////////////////////////////////////////////////
@@ -35,11 +38,13 @@
 
 
 tInsMode MIDITrack::ins_mode = INSMODE_INSERT_OR_REPLACE;
+std::atomic<unsigned long long> MIDITrack::last_edit_gen(0);
 
 
 MIDITrack::MIDITrack(MIDIClockTime end_time) : status(INIT_STATUS), rec_chan(-1),
-    time_shift(0), in_port(0), out_port() {
+    time_shift(0), in_port(0), out_port(), bulk_start(0), note_offs_valid(false), edit_gen(NewEditGeneration()) {
 // a track always contains at least the MIDI_END event, so num_events > 0
+    ResetCounters();
     MIDITimedMessage msg;
     msg.SetDataEnd();
     msg.SetTime(end_time);
@@ -48,17 +53,28 @@ MIDITrack::MIDITrack(MIDIClockTime end_time) : status(INIT_STATUS), rec_chan(-1)
 
 
 MIDITrack::MIDITrack(const MIDITrack &trk) : events(trk.events), status(trk.status), rec_chan(trk.rec_chan),
-                     time_shift(trk.time_shift), in_port(trk.in_port), out_port(trk.out_port)
-{}
+                     time_shift(trk.time_shift), in_port(trk.in_port), out_port(trk.out_port), bulk_start(0),
+                     note_offs_valid(false),
+                     main_metas(trk.main_metas), text_metas(trk.text_metas), sysexes(trk.sysexes),
+                     reset_sysexes(trk.reset_sysexes), edit_gen(NewEditGeneration()) {
+    std::copy(trk.chan_events, trk.chan_events + 16, chan_events);
+}
 
 
 MIDITrack& MIDITrack::operator=(const MIDITrack &trk) {
     events = trk.events;
+    note_offs_valid = false;
     rec_chan = trk.rec_chan;
     status = trk.status;
     time_shift = trk.time_shift;
     in_port = trk.in_port;
     out_port = trk.out_port;
+    std::copy(trk.chan_events, trk.chan_events + 16, chan_events);
+    main_metas = trk.main_metas;
+    text_metas = trk.text_metas;
+    sysexes = trk.sysexes;
+    reset_sysexes = trk.reset_sysexes;
+    edit_gen = NewEditGeneration();
     return *this;
 }
 
@@ -73,12 +89,15 @@ void MIDITrack::Reset() {
 
 void MIDITrack::Clear(bool mantain_end) {
     MIDIClockTime end = mantain_end ? GetEndTime() : 0;
-    events.resize(0);       // destroys messages clearing sysex
+    events.clear();         // destroys messages clearing sysex
     MIDITimedMessage msg;
     msg.SetDataEnd();
     msg.SetTime(end);
     events.push_back(msg);
     status = INIT_STATUS;
+    note_offs_valid = false;
+    ResetCounters();
+    edit_gen = NewEditGeneration();
 }
 
 
@@ -148,7 +167,13 @@ bool MIDITrack::SetChannel(int chan) {
         if (GetEvent(i).IsChannelMsg())
             GetEvent(i).SetChannel(chan);
     }
-    status |= STATUS_DIRTY;
+    unsigned int num_chan_events = 0;
+    for (int i = 0; i < 16; i++) {
+        num_chan_events += chan_events[i];
+        chan_events[i] = 0;
+    }
+    chan_events[chan] = num_chan_events;
+    SetDirty();
     return true;
 }
 
@@ -190,15 +215,35 @@ MIDIClockTime MIDITrack::GetNoteLength(const MIDITimedMessage& msg) const {
     if(!msg.IsNoteOn()) return 0;                           // msg isn't aNoteOn
     int ev_num;
     if (!FindEventNumber(msg, &ev_num)) return 0;           // msg isn't in the track
-    while (IsValidEventNum(ev_num)) {                       // search for the corresponding Note Off
-        if (events[ev_num].IsNoteOff() &&
-            events[ev_num].GetChannel() == msg.GetChannel() &&
-            events[ev_num].GetNote() == msg.GetNote())
-            return events[ev_num].GetTime() - msg.GetTime();// returns the length of the note
-        ev_num++;
-    }
+    int off_num = GetNoteOffNumber(ev_num);                 // the corresponding Note Off
+    if (off_num == -1)
         // this should not happen: there wasn't the corresponding Note Off
-    return TIME_INFINITE;
+        return TIME_INFINITE;
+    return events[off_num].GetTime() - msg.GetTime();       // returns the length of the note
+}
+
+
+int MIDITrack::GetNoteOffNumber(int ev_num) const {
+    if (!IsValidEventNum(ev_num))
+        return -1;
+    if (!IsNoteIndexValid()) {                              // the index is not valid: rebuild it
+        std::lock_guard<std::mutex> lock(note_offs_mutex);  // other readers could be rebuilding it
+        if (!IsNoteIndexValid()) {
+            // scan the track backwards, remembering the first Note Off of every channel and note
+            int next_off[16][128];
+            std::fill(&next_off[0][0], &next_off[0][0] + 16 * 128, -1);
+            note_offs.assign(events.size(), -1);
+            for (int i = events.size() - 1; i >= 0; i--) {
+                const MIDITimedMessage& msg = events[i];
+                if (msg.IsNoteOff())
+                    next_off[msg.GetChannel()][msg.GetNote()] = i;
+                else if (msg.IsNoteOn())
+                    note_offs[i] = next_off[msg.GetChannel()][msg.GetNote()];
+            }
+            note_offs_valid.store(true, std::memory_order_release);
+        }
+    }
+    return note_offs[ev_num];
 }
 
 
@@ -209,12 +254,18 @@ void MIDITrack::SetInsertMode(tInsMode mode) {
 
 
 bool MIDITrack::InsertEvent(const MIDITimedMessage& msg, tInsMode mode) {
+    return InsertEvent(MIDITimedMessage(msg), mode);    // copies the message only once
+}
+
+
+bool MIDITrack::InsertEvent(MIDITimedMessage&& msg, tInsMode mode) {
     if (msg.IsDataEnd()) return false;                  // DATA_END only auto managed
 
     if (GetEndTime() < msg.GetTime()) {                 // insert as last event
         SetEndTime(msg.GetTime());                      // adjust DATA_END
-        events.insert(events.end() - 1, msg);           // insert just before DATA_END
-        status |= STATUS_DIRTY;
+        CountEvent(msg, 1);
+        events.insert(events.size() - 1, std::move(msg)); // insert just before DATA_END
+        SetDirty();
         return true;
     }
 
@@ -232,16 +283,19 @@ bool MIDITrack::InsertEvent(const MIDITimedMessage& msg, tInsMode mode) {
                 // find the right place among events with same time
             while (CompareEventsForInsert(msg, events[ev_num]) == 1)
                 ev_num++;
-            events.insert(events.begin() + ev_num, msg);
-            status |= STATUS_DIRTY;
+            CountEvent(msg, 1);
+            events.insert(ev_num, std::move(msg));
+            SetDirty();
             return true;
 
         case INSMODE_REPLACE:                           // replace a same kind event, or do nothing
                 // find a same kind event at same time
             while (IsValidEventNum(ev_num) && events[ev_num].GetTime() == msg.GetTime()) {
                 if (IsSameKind(events[ev_num], msg)) {
-                    events[ev_num] = msg;               // replace if found
-                    status |= STATUS_DIRTY;
+                    CountEvent(events[ev_num], -1);
+                    CountEvent(msg, 1);
+                    events[ev_num] = std::move(msg);    // replace if found
+                    SetDirty();
                     return true;
                 }
                 ev_num++;
@@ -254,8 +308,10 @@ bool MIDITrack::InsertEvent(const MIDITimedMessage& msg, tInsMode mode) {
             while (IsValidEventNum(ev_num) && events[ev_num].GetTime() == msg.GetTime()) {
                 if (IsSameKind(events[ev_num], msg) &&
                      (mode == INSMODE_INSERT_OR_REPLACE || !msg.IsNote())) {
-                    events[ev_num] = msg;               // replace if found
-                    status |= STATUS_DIRTY;
+                    CountEvent(events[ev_num], -1);
+                    CountEvent(msg, 1);
+                    events[ev_num] = std::move(msg);    // replace if found
+                    SetDirty();
                     return true;
                 }
                 ev_num++;
@@ -264,8 +320,9 @@ bool MIDITrack::InsertEvent(const MIDITimedMessage& msg, tInsMode mode) {
             ev_num = old_ev_num;
             while (CompareEventsForInsert(msg, events[ev_num]) == 1)
                 ev_num++;
-            events.insert(events.begin() + ev_num, msg);
-            status |= STATUS_DIRTY;
+            CountEvent(msg, 1);
+            events.insert(ev_num, std::move(msg));
+            SetDirty();
             return true;                                // insert
     }
 
@@ -275,6 +332,12 @@ bool MIDITrack::InsertEvent(const MIDITimedMessage& msg, tInsMode mode) {
 
 bool MIDITrack::InsertNote(const MIDITimedMessage& msg, MIDIClockTime len, tInsMode mode) {
     if (!msg.IsNoteOn()) return false;
+    return InsertNote(MIDITimedMessage(msg), len, mode);
+}
+
+
+bool MIDITrack::InsertNote(MIDITimedMessage&& msg, MIDIClockTime len, tInsMode mode) {
+    if (!msg.IsNoteOn()) return false;
 
     MIDITimedMessage msgoff(msg);                       // set our NOTE_OFF message
     msgoff.SetType(NOTE_OFF);
@@ -289,23 +352,16 @@ bool MIDITrack::InsertNote(const MIDITimedMessage& msg, MIDIClockTime len, tInsM
         case INSMODE_DEFAULT:                           // dummy, for avoiding a warning
         case INSMODE_INSERT:                            // always insert the event
         case INSMODE_INSERT_OR_REPLACE_BUT_NOTE:
-            InsertEvent(msg, mode);                     // always return true
-            InsertEvent(msgoff, mode);
+            InsertEvent(std::move(msg), mode);          // always return true
+            InsertEvent(std::move(msgoff), mode);
             return true;
 
         case INSMODE_REPLACE:                           // replace a same kind event, or do nothing
             if (FindEventNumber(msg, &ev_num, COMPMODE_SAMEKIND)) {
                                                         // search for a note on event (with same note)
-                events.erase(events.begin() + ev_num);  // remove it
-                while (IsValidEventNum(ev_num) ) {      // search for the note off
-                    if (events[ev_num].IsNoteOff() && events[ev_num].GetNote() == msg.GetNote()) {
-                        events.erase(events.begin() + ev_num);  // and remove
-                        break;
-                    }
-                    ev_num++;
-                }
-                InsertEvent(msg, INSMODE_INSERT);       // insert note on (always return true)
-                InsertEvent(msgoff, INSMODE_INSERT);    // insert note off
+                EraseNote(ev_num);                      // remove it with its note off
+                InsertEvent(std::move(msg), INSMODE_INSERT);    // insert note on (always return true)
+                InsertEvent(std::move(msgoff), INSMODE_INSERT); // insert note off
                 return true;
             }
             return false;                               // return false if not found
@@ -313,17 +369,10 @@ bool MIDITrack::InsertNote(const MIDITimedMessage& msg, MIDIClockTime len, tInsM
         case INSMODE_INSERT_OR_REPLACE:                 // replace a same kind, or insert
             if (FindEventNumber(msg, &ev_num, COMPMODE_SAMEKIND)) {
                                                         // search for a note on event (with same note)
-                events.erase(events.begin() + ev_num);  // remove it
-                while (IsValidEventNum(ev_num)) {       // search for the note off
-                    if (events[ev_num].IsNoteOff() && events[ev_num].GetNote() == msg.GetNote()) {
-                        events.erase(events.begin() + ev_num);  // and remove
-                        break;
-                    }
-                    ev_num++;
-                }
+                EraseNote(ev_num);                      // remove it with its note off
             }
-            InsertEvent(msg, INSMODE_INSERT);           // insert note on
-            InsertEvent(msgoff, INSMODE_INSERT);        // insert note off
+            InsertEvent(std::move(msg), INSMODE_INSERT);    // insert note on
+            InsertEvent(std::move(msgoff), INSMODE_INSERT); // insert note off
             return true;
     }
 // NOTE: this calls InsertEvent and RemoveEvent always with correct arguments, so they should return true
@@ -340,8 +389,9 @@ bool MIDITrack::DeleteEvent( const MIDITimedMessage& msg ) {
     int ev_num;
     if (!FindEventNumber(msg, &ev_num))
         return false;
-    events.erase(events.begin() + ev_num);
-    status |= STATUS_DIRTY;
+    CountEvent(events[ev_num], -1);
+    events.erase(ev_num);
+    SetDirty();
     return true;
 }
 
@@ -353,25 +403,97 @@ bool MIDITrack::DeleteNote( const MIDITimedMessage& msg ) {
     int ev_num;
     if (!FindEventNumber(msg, &ev_num))
         return false;
-    events.erase(events.begin() + ev_num);
-    while (IsValidEventNum(ev_num)) {
-        if (events[ev_num].IsNoteOff() && events[ev_num].GetNote() == msg.GetNote()) {
-            events.erase(events.begin() + ev_num);
-            break;
-        }
-        ev_num++;
-    }
+    EraseNote(ev_num);
     return true;
 }
 
+
+void MIDITrack::EraseNote(int ev_num) {
+    int off_num = -1;
+    if (IsNoteIndexValid())                             // use the index only if it is valid, as we are
+        off_num = note_offs[ev_num];                    // going to invalidate it
+    else {
+        const MIDITimedMessage& msg = events[ev_num];
+        for (unsigned int i = ev_num + 1; i < events.size(); i++)
+            if (events[i].IsNoteOff() && events[i].GetChannel() == msg.GetChannel() &&
+                events[i].GetNote() == msg.GetNote()) {
+                off_num = i;
+                break;
+            }
+    }
+    if (off_num != -1) {
+        CountEvent(events[off_num], -1);
+        events.erase(off_num);                          // erase the note off first, so ev_num is still valid
+    }
+    CountEvent(events[ev_num], -1);
+    events.erase(ev_num);
+    SetDirty();
+}
+
 // NEW
 void MIDITrack::PushEvent(const MIDITimedMessage& msg) {
     if (msg.IsDataEnd()) return;                        // DATA_END only auto managed
 
     if (GetEndTime() < msg.GetTime())
         SetEndTime(msg.GetTime());                      // adjust DATA_END
-    events.insert(events.end() - 1, msg);               // insert just before DATA_END
-    status |= STATUS_DIRTY;
+    CountEvent(msg, 1);
+    events.insert(events.size() - 1, msg);              // insert just before DATA_END
+    SetDirty();
+}
+
+
+void MIDITrack::PushEvent(MIDITimedMessage&& msg) {
+    if (msg.IsDataEnd()) return;
+
+    if (GetEndTime() < msg.GetTime())
+        SetEndTime(msg.GetTime());
+    CountEvent(msg, 1);
+    events.insert(events.size() - 1, std::move(msg));
+    SetDirty();
+}
+
+
+// The order given by CompareEventsForInsert() to events with the same time, as a number (the function itself
+// cannot be used for sorting, because it doesn't compare channels symmetrically: its effect is to put
+// higher channels first). Other system messages, which it doesn't order, go before channel messages.
+static int InsertRank(const MIDITimedMessage& msg) {
+    if (msg.IsNoOp())
+        return 0x100;
+    if (msg.IsMetaEvent())
+        return 0;
+    if (msg.IsSysEx())
+        return 0x80;
+    if (!msg.IsChannelMsg())
+        return 1;
+    return 2 + (15 - msg.GetChannel()) * 3 + (msg.IsNote() ? (msg.IsNoteOn() ? 2 : 1) : 0);
+}
+
+
+static bool InsertLess(const MIDITimedMessage& m1, const MIDITimedMessage& m2) {
+    if (m1.GetTime() != m2.GetTime())
+        return m1.GetTime() < m2.GetTime();
+    return InsertRank(m1) < InsertRank(m2);
+}
+
+
+void MIDITrack::BeginBulkInsert(unsigned int num_events) {
+    events.reserve(events.size() + num_events);
+    bulk_start = events.size() - 1;                     // the DATA_END position
+}
+
+
+void MIDITrack::EndBulkInsert() {
+    if (bulk_start >= events.size() - 1)                // no events were pushed
+        return;
+    MIDITimedMessage* begin = events.data();            // makes the events contiguous
+    MIDITimedMessage* first = begin + bulk_start;
+    MIDITimedMessage* last = begin + events.size() - 1; // the DATA_END
+    std::stable_sort(first, last, InsertLess);
+    std::inplace_merge(begin, first, last, InsertLess);
+    if (GetEndTime() < (last - 1)->GetTime())           // SetEndTime() may have been called in the meanwhile
+        events.back().SetTime((last - 1)->GetTime());
+    bulk_start = events.size() - 1;
+    SetDirty();
 }
 
 
@@ -380,20 +502,15 @@ void MIDITrack::InsertInterval(MIDIClockTime start, MIDIClockTime length, const
 
     CloseOpenEvents(0, start);                          // truncate notes, pedal, bender at start
     int start_n;
-    if (FindEventNumber(start, &start_n)) {             // there are events after start time
+    FindEventNumber(start, &start_n);
+    if (start_n != -1) {                                // there are events after start time
         for (unsigned int i = start_n; i < events.size(); i++)
             events[i].AddTime(length);                  // moves these events
+        SetDirty();
     }
     if(!src) return;                                    // we want only move events
 
-    for(unsigned int i = 0; i < src->GetNumEvents(); i++) {
-                                                        // else inserts events in src
-        MIDITimedMessage msg = src->events[i];
-        if (msg.GetTime() >= length) break;             // edit is too long
-        msg.AddTime(start);                             // TODO: don't insert time, key and tempo messages if
-                                                        // already present
-        InsertEvent(msg);
-    }
+    CopyInterval(start, length, src);                   // else inserts events in src
     CloseOpenEvents(start, start + length);             // truncate at end
 }
 
@@ -436,8 +553,10 @@ void MIDITrack::DeleteInterval(MIDIClockTime start, MIDIClockTime end) {
     ClearInterval(start, end);
     int ev_num;
     FindEventNumber(end, &ev_num);                  // an event surely exists
+    MIDIClockTime length = end - start;
     for (unsigned int i = ev_num; i < events.size(); i++)
-        events[i].SubTime(end - start);             // shifts subsequents events
+        events[i].SubTime(length);                  // shifts subsequents events
+    SetDirty();
 }
 
 
@@ -449,25 +568,28 @@ void MIDITrack::ClearInterval(MIDIClockTime start, MIDIClockTime end) {
     CloseOpenEvents(0, start);                      // truncate open events BEFORE start (so delete
                                                     // note off, etc in edit track)
     CloseOpenEvents(start, end);                    // truncate at end
-    int ev_num;
-    int ev_to_remove = 0;
+    int ev_num, end_num;
     FindEventNumber(start, &ev_num);                // an event surely exists
     while (events[ev_num].GetTime() == start &&
            (events[ev_num].IsNoteOff() || events[ev_num].IsPedalOff() ||
            (events[ev_num].IsPitchBend() && events[ev_num].GetBenderValue() == 0)))
         ev_num++;                                   // skip these events at the beginning of the interval
-    while (events[ev_num].GetTime() < end) {        // surely we won't reach the DataEnd (end previously adjusted)
-        ev_num++;
-        ev_to_remove++;
+    FindEventNumber(end, &end_num);                 // the first event with time >= end (surely we won't
+                                                    // go beyond the DataEnd, as end was previously adjusted)
+    if (end_num > ev_num) {
+        for (int i = ev_num; i < end_num; i++)
+            CountEvent(events[i], -1);
+        events.erase(ev_num, end_num - ev_num);     // deletes events between start and end-1
     }
-    events.erase(events.begin() + ev_num, events.begin() + ev_num + ev_to_remove);
-                                                    // deletes events between start and end-1
     while (events[ev_num].GetTime() == end && !events[ev_num].IsDataEnd())
         if (events[ev_num].IsNoteOff() || events[ev_num].IsPedalOff() ||
-            (events[ev_num].IsPitchBend() && events[ev_num].GetBenderValue() == 0))
-            events.erase(events.begin() + ev_num);  // deletes NOTE OFF,PEDAL OFF and unneded PITCH BEND at end
+            (events[ev_num].IsPitchBend() && events[ev_num].GetBenderValue() == 0)) {
+            CountEvent(events[ev_num], -1);
+            events.erase(ev_num);  // deletes NOTE OFF,PEDAL OFF and unneded PITCH BEND at end
+        }
         else
             ev_num++;
+    SetDirty();
 }
 
 
@@ -475,103 +597,287 @@ void MIDITrack::ReplaceInterval(MIDIClockTime start, MIDIClockTime end, const MI
     if (end <= start || src == 0) return;
 
     ClearInterval(start, end);                      // deletes all events in the interval
-    for(unsigned int i = 0; i < src->GetNumEvents(); i++) {
-        MIDITimedMessage msg(src->GetEvent(i));     // inserts events
-        if (msg.GetTime() >= end - start) break;    // edit is too long
-        msg.AddTime(start);
-        InsertEvent(msg);
-    }
+    CopyInterval(start, end - start, src);          // inserts events
     CloseOpenEvents(start, end);                    // truncate at end
 }
 
 
-/* This is the old function, more complicated, but working even on tracks with mixed
-   MIDI channels
-*/
+void MIDITrack::CopyInterval(MIDIClockTime start, MIDIClockTime length, const MIDITrack* src) {
+    unsigned int first = 0;
+    int last;
+    for ( ; first < src->events.size() - 1 && src->events[first].GetTime() == 0; first++) {
+        MIDITimedMessage msg(src->events[first]);   // these must be merged with the events at start time:
+        msg.AddTime(start);                         // insert them one by one
+        InsertEvent(std::move(msg));
+    }
+    if (!src->FindEventNumber(length, &last) && last == -1)
+        last = src->events.size() - 1;              // src is shorter than length
+    if (last <= (int)first) return;                 // nothing more to copy
+
+    int ev_num;                                     // the interval (apart from the start time) is empty,
+    FindEventNumber(start + length, &ev_num);       // so the other events can be copied in a single block
+    if (ev_num == -1)                               // before the events at start + length
+        ev_num = events.size() - 1;
+    unsigned int n = last - first;
+    events.insert(ev_num, src->events, first, n);
+    for (unsigned int i = ev_num; i < ev_num + n; i++) {
+        events[i].AddTime(start);                   // adjust message time
+        CountEvent(events[i], 1);
+    }
+    SetEndTime(std::max(GetEndTime(), events[ev_num + n - 1].GetTime()));
+    SetDirty();
+}
+
+
+// Works in a single sweep, on tracks with mixed MIDI channels too: the events from _from_ to _to_ are fed
+// to a MIDIMatrix, which gives the notes and pedals still on at _to_ (the bender is followed separately);
+// for every one of them a closing event at _to_ is collected, and the events after _to_ are then scanned
+// only until all their matching off events are found. These are removed with a single compaction pass and
+// the sorted closing events are inserted as a block and merged with the events at time _to_.
 void MIDITrack::CloseOpenEvents(MIDIClockTime from, MIDIClockTime to) {
     if (to == 0 || to >= GetEndTime()) return;      // there aren't open events at beginning or end
+    if (from > to) return;
 
     MIDIMatrix matrix;
     int pitchbend[16];
-    MIDITimedMessage msg;
-    unsigned int ev_num = 0;
-    for (int i = 0; i < 16; i++)
-        pitchbend[i] = 0;
-    // ignore events before from
-    while (ev_num < GetNumEvents() - 1 && GetEvent(ev_num + 1).GetTime() < from)
-        ev_num++;
-    // scan events before current time, remembering notes, pedal and pitch bend
-    while (ev_num < GetNumEvents() && (msg = GetEvent(ev_num)).GetTime() < to) {
-        matrix.Process(&msg);
-        if (msg.IsPitchBend())
-            pitchbend[msg.GetChannel()] = msg.GetBenderValue();
-        ev_num++;
+    bool pedal_again[16];                           // the pedal is pressed again at time to
+    std::fill(pitchbend, pitchbend + 16, 0);
+    std::fill(pedal_again, pedal_again + 16, false);
+    int ev_num;
+    FindEventNumber(from, &ev_num);                 // the first event with time >= from
+    // scan events before to, remembering notes, pedal and pitch bend
+    for ( ; events[ev_num].GetTime() < to; ev_num++) {
+        matrix.Process(&events[ev_num]);
+        if (events[ev_num].IsPitchBend())
+            pitchbend[events[ev_num].GetChannel()] = events[ev_num].GetBenderValue();
     }
-    // now scan events at current time, closing open notes, pedal and pitch bend
-    while (ev_num < GetNumEvents() && (msg = GetEvent(ev_num)).GetTime() == to) {
+    // now scan events at time to: they can close open notes and pedal, or set the bender again
+    unsigned int to_start = ev_num;
+    for ( ; events[ev_num].GetTime() == to; ev_num++) {
+        MIDITimedMessage& msg = events[ev_num];
         if (msg.IsNoteOff() || msg.IsPedalOff())
-            matrix.Process (&msg);
-        if (msg.IsPitchBend() && msg.GetBenderValue() == 0)
-            pitchbend[msg.GetChannel()] = msg.GetBenderValue();
-        ev_num++;
-    }                                           // ev_num is now the index of 1st event with timw > t
-
-    for (int ch = 0; ch < 16; ch++) {           // for every channel ...
-        // get the number of notes on of the channel
-        int note_count = matrix.GetChannelCount(ch);
-        // search which notes are on
-        for (int note = matrix.GetMinNoteOn(ch); note_count > 0 && note <= matrix.GetMaxNoteOn(ch); note++) {
-            // if the note is on ... (i should normally be 1)
-            for (int i = matrix.GetNoteCount(ch, note); i > 0; i--) {
-                msg.SetNoteOff(ch, note, 0);
-                msg.SetTime(to);
-                InsertEvent(msg);               // ... insert a note off at time to
-                ev_num++;                       // ... adjust ev_num ...
-                note_count--;                   // ... and decrease note_count
-                // now search the corresponding note off after t ...
-                for (unsigned int j = ev_num; j < GetNumEvents(); j++) {
-                    msg = GetEvent(j);
-                    if (msg.IsNoteOff() && msg.GetChannel() == ch && msg.GetNote() == note ) {
-                        DeleteEvent( msg );     // ... and delete it
-                        break;
-                    }
-                }
+            matrix.Process(&msg);
+        else if (msg.IsPedalOn())
+            pedal_again[msg.GetChannel()] = true;
+        else if (msg.IsPitchBend())
+            pitchbend[msg.GetChannel()] = 0;
+    }                                               // ev_num is now the index of 1st event with time > to
+
+    // collect the closing events, and remember the events after to which must be deleted
+    MIDIEventBuffer closing;
+    MIDITimedMessage close_msg;
+    close_msg.SetTime(to);
+    int pending_offs[16][128];                      // the Note Off of the closed notes
+    bool pending_pedal[16];                         // the pedal off of the closed pedal
+    bool pending_bend[16];                          // the pitch bend not yet returned to 0
+    unsigned int num_pending = 0;
+    for (int ch = 0; ch < 16; ch++) {
+        for (int note = 0; note < 128; note++) {
+            pending_offs[ch][note] = matrix.GetNoteCount(ch, note);
+            for (int i = pending_offs[ch][note]; i > 0; i--) {
+                close_msg.SetNoteOff(ch, note, 0);
+                closing.push_back(close_msg);
+                num_pending++;
+            }
+        }
+        pending_pedal[ch] = matrix.GetHoldPedal(ch);
+        if (pending_pedal[ch]) {
+            close_msg.SetControlChange(ch, C_DAMPER, 0);
+            closing.push_back(close_msg);
+            if (pedal_again[ch])                    // the next pedal off is of the new pedal
+                pending_pedal[ch] = false;
+            else
+                num_pending++;
+        }
+        pending_bend[ch] = (pitchbend[ch] != 0);
+        if (pending_bend[ch]) {
+            close_msg.SetPitchBend(ch, 0);
+            closing.push_back(close_msg);
+            num_pending++;
+        }
+    }
+    if (closing.empty())
+        return;
+
+    // scan events after to (only until all the pending events are found)
+    std::vector<unsigned int> to_delete;
+    for (unsigned int i = ev_num; num_pending > 0 && i < events.size() - 1; i++) {
+        const MIDITimedMessage& msg = events[i];
+        if (!msg.IsChannelMsg())
+            continue;
+        int ch = msg.GetChannel();
+        if (msg.IsNoteOff()) {
+            int note = msg.GetNote();
+            if (pending_offs[ch][note] > 0) {       // the Note Off of a closed note: delete it
+                to_delete.push_back(i);
+                pending_offs[ch][note]--;
+                num_pending--;
+            }
+        }
+        else if (msg.IsPedalOn() || msg.IsPedalOff()) {
+            if (pending_pedal[ch]) {                // delete the first pedal off, unless the pedal
+                if (msg.IsPedalOff())               // is pressed again before it
+                    to_delete.push_back(i);
+                pending_pedal[ch] = false;
+                num_pending--;
+            }
+        }
+        else if (msg.IsPitchBend() && pending_bend[ch]) {
+            if (msg.GetBenderValue() != 0)          // delete pitch bend messages until a 0 value
+                to_delete.push_back(i);
+            else {
+                pending_bend[ch] = false;
+                num_pending--;
+            }
+        }
+    }
 
+    // delete all the events in a single pass (they are all after the closing events) ...
+    if (!to_delete.empty()) {
+        MIDITimedMessage* ev = events.data();       // makes the events contiguous
+        unsigned int j = to_delete[0], k = 0;
+        for (unsigned int i = to_delete[0]; i < events.size(); i++) {
+            if (k < to_delete.size() && i == to_delete[k]) {
+                CountEvent(ev[i], -1);
+                k++;
             }
+            else
+                ev[j++] = std::move(ev[i]);
         }
+        events.erase(j, events.size() - j);
+    }
+    // ... and insert the closing events in a single block, before the events at time to
+    MIDITimedMessage* first = closing.data();
+    MIDITimedMessage* last = first + closing.size();
+    std::stable_sort(first, last, InsertLess);
+    for (MIDITimedMessage* p = first; p < last; p++)
+        CountEvent(*p, 1);
+    events.insert(to_start, closing, 0, closing.size());
+    MIDITimedMessage* ev = events.data();
+    std::inplace_merge(ev + to_start, ev + to_start + closing.size(), ev + ev_num + closing.size(), InsertLess);
+    SetDirty();
+}
 
-        if (matrix.GetHoldPedal(ch)) {
-            msg.SetControlChange(ch, C_DAMPER, 0);
-            msg.SetTime(to);
-            InsertEvent(msg);
-            ev_num++;
-            for (unsigned int j = ev_num; j < GetNumEvents(); j++) {
-                // search the corresponding pedal off after to ...
-                msg = GetEvent(j);
-                if (msg.IsPedalOff() && msg.GetChannel() == ch) {
-                    DeleteEvent(msg);           // ... and delete it
-                    break;
-                }
+
+void MIDITrack::Transform(const MIDITransform& tr) {
+    unsigned int num_events = events.size() - 1;       // DATA_END excluded
+    std::vector<MIDIClockTime> new_times;
+    if (tr.ChangesTimes()) {
+        new_times.resize(num_events);
+        for (unsigned int i = 0; i < num_events; i++)
+            new_times[i] = tr.StretchTime(events[i].GetTime());
+        if (tr.GetQuantize() != 0) {                    // needs the note pairs of the original track
+            // overlapping notes of the same pitch get the same Note Off from GetNoteOffNumber(): every
+            // Note Off must be moved only once, so the next free one is given to the later notes
+            std::vector<bool> off_used(num_events, false);
+            for (unsigned int i = 0; i < num_events; i++) {
+                int off_num = GetNoteOffNumber(i);
+                if (off_num == -1)                      // not a note on, or without note off
+                    continue;
+                while (off_num < (int)num_events && (off_used[off_num] || !events[off_num].IsNoteOff() ||
+                       events[off_num].GetChannel() != events[i].GetChannel() ||
+                       events[off_num].GetNote() != events[i].GetNote()))
+                    off_num++;
+                if (off_num == (int)num_events)         // all its Note Off are taken
+                    continue;
+                off_used[off_num] = true;
+                MIDIClockTime on_time = tr.QuantizeTime(new_times[i]);
+                long off_time = (long)new_times[off_num] + (long)on_time - (long)new_times[i];
+                new_times[off_num] = off_time < (long)on_time ? on_time : off_time;
+                new_times[i] = on_time;                 // moves the note keeping its length
             }
         }
+    }
 
-        if (pitchbend[ch]) {
-            msg.SetPitchBend(ch, 0);
-            msg.SetTime(to);
-            InsertEvent(msg);
-            ev_num++;
-            for (unsigned int j = ev_num; j < GetNumEvents(); j++) {
-                // search other pitch bend messages after to until we find a 0 value ...
-                msg = GetEvent(j);
-                if (msg.IsPitchBend() && msg.GetChannel() == ch) {
-                    if (msg.GetBenderValue() != 0)
-                        DeleteEvent(msg);       // ... and delete it
-                    else
-                        break;
+    MIDITimedMessage* ev = events.data();               // makes the events contiguous
+    for (unsigned int i = 0; i < num_events; i++) {
+        if (tr.ChangesTimes())
+            ev[i].SetTime(new_times[i]);
+        if (ev[i].IsChannelMsg()) {
+            int chan = ev[i].GetChannel();
+            tr.ProcessMessage(ev[i]);
+            if (ev[i].GetChannel() != chan) {           // keep the counters updated
+                chan_events[chan]--;
+                chan_events[ev[i].GetChannel()]++;
+            }
+        }
+    }
+    if (tr.ChangesTimes() || tr.ChangesChannels()) {
+        if (!std::is_sorted(ev, ev + num_events, InsertLess))
+            std::stable_sort(ev, ev + num_events, InsertLess);
+        MIDIClockTime end_time = tr.StretchTime(GetEndTime());
+        if (num_events > 0 && ev[num_events - 1].GetTime() > end_time)
+            end_time = ev[num_events - 1].GetTime();
+        ev[num_events].SetTime(end_time);
+    }
+    SetDirty();
+}
+
+
+unsigned int MIDITrack::Compact(MIDIProcessorCompactor& comp) {
+    // A zero length note is sorted as a Note Off followed by its Note On at the same time, so the Note On
+    // remains without its Note Off. When we find a Note On at the same time of a Note Off closing no note, we
+    // keep them as candidates, and delete them if the next event of the same note is not a Note Off.
+    unsigned int num_events = events.size() - 1;       // DATA_END excluded
+    std::vector<bool> to_delete(num_events, false);
+    int open_notes[16][128];                            // the number of sounding notes
+    int orphan_off[16][128];                            // the last Note Off closing no note
+    int empty_on[16][128];                              // the Note On of a candidate zero length note ...
+    int empty_off[16][128];                             // ... and its Note Off
+    std::fill(&open_notes[0][0], &open_notes[0][0] + 16 * 128, 0);
+    std::fill(&orphan_off[0][0], &orphan_off[0][0] + 16 * 128, -1);
+    std::fill(&empty_on[0][0], &empty_on[0][0] + 16 * 128, -1);
+
+    comp.ResetValues();
+    for (unsigned int i = 0; i < num_events; i++) {
+        const MIDITimedMessage& msg = events[i];
+        if (msg.IsNote() && comp.GetRemoveEmptyNotes()) {
+            int chan = msg.GetChannel(), note = msg.GetNote();
+            if (msg.IsNoteOn()) {
+                if (empty_on[chan][note] != -1)         // the candidate had no Note Off: delete it
+                    to_delete[empty_on[chan][note]] = to_delete[empty_off[chan][note]] = true;
+                empty_on[chan][note] = -1;
+                int off = orphan_off[chan][note];
+                orphan_off[chan][note] = -1;
+                if (off != -1 && events[off].GetTime() == msg.GetTime()) {
+                    empty_on[chan][note] = i;
+                    empty_off[chan][note] = off;
                 }
+                else
+                    open_notes[chan][note]++;
             }
+            else if (empty_on[chan][note] != -1)        // the candidate was a true note
+                empty_on[chan][note] = -1;
+            else if (open_notes[chan][note] > 0)
+                open_notes[chan][note]--;
+            else
+                orphan_off[chan][note] = i;
+        }
+        else if (!comp.Check(msg, msg.GetTime()))
+            to_delete[i] = true;
+    }
+    for (int chan = 0; chan < 16; chan++)               // the candidates left at the end of the track
+        for (int note = 0; note < 128; note++)
+            if (empty_on[chan][note] != -1)
+                to_delete[empty_on[chan][note]] = to_delete[empty_off[chan][note]] = true;
+
+    MIDITimedMessage* ev = events.data();               // makes the events contiguous
+    unsigned int j = 0;
+    for (unsigned int i = 0; i < num_events; i++) {
+        if (to_delete[i])
+            CountEvent(ev[i], -1);
+        else {
+            if (j != i)
+                ev[j] = std::move(ev[i]);
+            j++;
         }
     }
+    if (j == num_events)
+        return 0;
+    ev[j] = std::move(ev[num_events]);                  // the DATA_END
+    events.erase(j + 1, num_events - j);
+    SetDirty();
+    return num_events - j;
 }
 
 
@@ -641,27 +947,24 @@ bool MIDITrack::FindEventNumber(MIDIClockTime time, int* event_num) const {
 
 
 void MIDITrack::Analyze() {
+    status = INIT_STATUS;
+    if (main_metas)
+        status |= HAS_MAIN_META;
+    if (text_metas)
+        status |= HAS_TEXT_META;
+    if (sysexes)
+        status |= HAS_SYSEX;
+    if (reset_sysexes)
+        status |= HAS_RESET_SYSEX;
     signed char channel = -1;
-    const MIDITimedMessage* msg;
-    for (unsigned int i = 0; i < GetNumEvents(); i++) {
-        msg = GetEventAddress(i);
-        if (msg->IsMetaEvent() && !msg->IsDataEnd()) {
-            if (msg->IsTextEvent())
-                status |= HAS_TEXT_META;
-            else
-                status |= HAS_MAIN_META;
-        }
-        else if (msg->IsChannelMsg()) {
-            if (channel == -1)
-                channel = msg->GetChannel();
-            else if (channel != msg->GetChannel())
-                status |= HAS_MANY_CHAN;
-        }
-        else if (msg->IsSysEx()) {
-            if (msg->GetSysEx()->IsGMReset() || msg->GetSysEx()->IsGSReset() || msg->GetSysEx()->IsXGReset())
-                status |= HAS_RESET_SYSEX;
-            else
-                status |= HAS_SYSEX;
+    for (int ch = 0; ch < 16; ch++) {
+        if (chan_events[ch] == 0)
+            continue;
+        if (channel == -1)
+            channel = ch;
+        else {
+            status |= HAS_MANY_CHAN;
+            break;
         }
     }
     if (channel != -1 && !(status & HAS_MANY_CHAN)) {
@@ -669,7 +972,31 @@ void MIDITrack::Analyze() {
         status &= 0xffffff00;
         status |= channel;
     }
-    status &= (~STATUS_DIRTY);
+}
+
+
+void MIDITrack::CountEvent(const MIDITimedMessage& msg, int n) {
+    uint16_t cat = msg.Classify();
+    if ((cat & MSG_META) && !msg.IsDataEnd()) {
+        if (msg.IsTextEvent())
+            text_metas += n;
+        else
+            main_metas += n;
+    }
+    else if (cat & MSG_CHANNEL)
+        chan_events[msg.GetChannel()] += n;
+    else if (cat & MSG_SYSEX) {
+        if (msg.GetSysEx()->IsGMReset() || msg.GetSysEx()->IsGSReset() || msg.GetSysEx()->IsXGReset())
+            reset_sysexes += n;
+        else
+            sysexes += n;
+    }
+}
+
+
+void MIDITrack::ResetCounters() {
+    std::fill(chan_events, chan_events + 16, 0);
+    main_metas = text_metas = sysexes = reset_sysexes = 0;
 }
 
 
@@ -0,0 +1,79 @@
+/*
+ *   NiCMidi - A C++ Class Library for MIDI
+ *
+ *   Copyright (C) 2021, 2022  Nicola Cassetta
+ *   https://github.com/ncassetta/NiCMidi
+ *
+ *   This file is part of NiCMidi.
+ *
+ *   NiCMidi is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   NiCMidi is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with NiCMidi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "../include/transform.h"
+
+
+/////////////////////////////////////////////////
+//            class MIDITransform              //
+/////////////////////////////////////////////////
+
+
+void MIDITransform::Reset() {
+    for (int i = 0; i < 16; i++) {
+        trans_amount[i] = 0;
+        chan_map[i] = i;
+    }
+    for (int i = 0; i < 128; i++)
+        vel_curve[i] = i;
+    stretch = 1.0;
+    grid = 0;
+}
+
+
+void MIDITransform::SetAllTranspose(int trans) {
+    for (int i = 0; i < 16; i++)
+        trans_amount[i] = trans;
+}
+
+
+void MIDITransform::SetAllChannels(int dest_chan) {
+    for (int i = 0; i < 16; i++)
+        chan_map[i] = dest_chan;
+}
+
+
+void MIDITransform::SetVelocityCurve(const unsigned char curve[128]) {
+    vel_curve[0] = 0;                       // a Note On never has 0 velocity
+    for (int i = 1; i < 128; i++) {
+        unsigned char vel = curve[i] & 0x7f;
+        vel_curve[i] = vel == 0 ? 1 : vel;
+    }
+}
+
+
+void MIDITransform::SetVelocityScale(int percent, int offset) {
+    vel_curve[0] = 0;
+    for (int i = 1; i < 128; i++) {
+        int vel = i * percent / 100 + offset;
+        vel_curve[i] = vel < 1 ? 1 : (vel > 127 ? 127 : vel);
+    }
+}
+
+
+bool MIDITransform::ChangesChannels() const {
+    for (int i = 0; i < 16; i++)
+        if (chan_map[i] != i)
+            return true;
+    return false;
+}
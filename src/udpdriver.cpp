@@ -0,0 +1,475 @@
+/*
+ *   NiCMidi - A C++ Class Library for MIDI
+ *
+ *   Copyright (C) 2021, 2022  Nicola Cassetta
+ *   https://github.com/ncassetta/NiCMidi
+ *
+ *   This file is part of NiCMidi.
+ *
+ *   NiCMidi is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   NiCMidi is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with NiCMidi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "../include/udpdriver.h"
+
+#ifndef WIN32
+
+#include <iostream>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+
+// Datagram layout (all numbers are big endian):
+//  0   'N' 'M'             magic
+//  2   version             (1)
+//  3   journal count       number of journal sections after the command section
+//  4   seq                 16 bit sequence number
+//  6   timestamp           32 bit sender time in msecs
+// 10   cmd length          16 bit
+// 12   cmd                 for every message: delta time from timestamp (var len), length (var len), bytes
+// then every journal section has the same seq, timestamp, cmd length and cmd of an older datagram.
+
+static const unsigned char UDP_VERSION = 1;
+static const unsigned int UDP_HEADER_LENGTH = 4;
+static const unsigned int UDP_SECTION_HEADER_LENGTH = 8;
+
+
+static void Put16(std::vector<unsigned char>& v, uint16_t n) {
+    v.push_back(n >> 8);
+    v.push_back(n & 0xff);
+}
+
+
+static void Put32(std::vector<unsigned char>& v, uint32_t n) {
+    Put16(v, n >> 16);
+    Put16(v, n & 0xffff);
+}
+
+
+static void PutVarLen(std::vector<unsigned char>& v, uint32_t n) {
+    unsigned char buf[5];
+    int i = 0;
+    buf[i++] = n & 0x7f;
+    while (n >>= 7)
+        buf[i++] = (n & 0x7f) | 0x80;
+    while (i > 0)
+        v.push_back(buf[--i]);
+}
+
+
+static uint16_t Get16(const unsigned char* p) {
+    return (p[0] << 8) | p[1];
+}
+
+
+static uint32_t Get32(const unsigned char* p) {
+    return ((uint32_t)Get16(p) << 16) | Get16(p + 2);
+}
+
+
+static bool GetVarLen(const unsigned char* p, unsigned int len, unsigned int& pos, uint32_t& n) {
+    n = 0;
+    for (int i = 0; i < 5 && pos < len; i++) {
+        unsigned char c = p[pos++];
+        n = (n << 7) | (c & 0x7f);
+        if (!(c & 0x80))
+            return true;
+    }
+    return false;
+}
+
+
+/////////////////////////////////////////////////
+//           class MIDIUdpOutDriver            //
+/////////////////////////////////////////////////
+
+
+MIDIUdpOutDriver::MIDIUdpOutDriver(int id, const std::string& h, unsigned short p, unsigned int jd) :
+    MIDIOutDriver(id, RtMidi::RTMIDI_DUMMY), host(h), udp_port(p),
+    journal_depth(jd > MAX_JOURNAL_DEPTH ? MAX_JOURNAL_DEPTH : jd), sock(-1),
+    auto_flush(true), next_seq(0), num_packets(0), num_messages(0) {
+    current.seq = 0;
+    current.timestamp = 0;
+}
+
+
+MIDIUdpOutDriver::~MIDIUdpOutDriver() {
+    if (sock != -1)
+        close(sock);
+}
+
+
+void MIDIUdpOutDriver::Reset() {
+    if (sock != -1) {
+        close(sock);
+        sock = -1;
+    }
+    current.cmd.clear();
+    journal.clear();
+    processor = 0;
+    num_open = 0;
+}
+
+
+std::string MIDIUdpOutDriver::GetPortName() {
+    return "udp:" + host + ":" + std::to_string(udp_port);
+}
+
+
+void MIDIUdpOutDriver::OpenPort() {
+    if (num_open == 0) {
+        memset(&dest, 0, sizeof(dest));
+        dest.sin_family = AF_INET;
+        dest.sin_port = htons(udp_port);
+        if (inet_pton(AF_INET, host.c_str(), &dest.sin_addr) != 1) {
+            std::cerr << "MIDIUdpOutDriver: invalid address " << host << std::endl;
+            return;
+        }
+        sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock == -1) {
+            std::cerr << "MIDIUdpOutDriver: cannot open socket" << std::endl;
+            return;
+        }
+        current.cmd.clear();
+        journal.clear();
+        num_packets = num_messages = 0;
+        out_notes.Reset();
+        ResetShadow();
+    }
+    num_open++;
+
+    std::cout << "OUT Port " << GetPortName() << " open";
+    if (num_open > 1)
+        std::cout << " (" << num_open << " times)";
+    std::cout<< std::endl;
+}
+
+
+void MIDIUdpOutDriver::ClosePort() {
+    if (num_open == 1) {
+        FlushOutput();
+        close(sock);
+        sock = -1;
+    }
+    if (num_open > 0) {
+        num_open--;
+        std::cout << "OUT Port " << GetPortName() << " closed";
+        if (num_open > 0)
+            std::cout << " (open " << num_open << " times)";
+        std::cout << std::endl;
+    }
+    else
+        std::cout << "OUT Port " << GetPortName()
+        << "Attempt to close an already closed port!" << std::endl;
+}
+
+
+void MIDIUdpOutDriver::FlushOutput() {
+    std::lock_guard<std::recursive_mutex> lock(out_mutex);
+    if (sock == -1 || current.cmd.size() == 0)
+        return;
+
+    current.seq = next_seq++;
+    packet.clear();
+    packet.push_back('N');
+    packet.push_back('M');
+    packet.push_back(UDP_VERSION);
+    packet.push_back((unsigned char)journal.size());
+    Put16(packet, current.seq);
+    Put32(packet, current.timestamp);
+    Put16(packet, current.cmd.size());
+    packet.insert(packet.end(), current.cmd.begin(), current.cmd.end());
+    for (unsigned int i = 0; i < journal.size(); i++) {
+        Put16(packet, journal[i].seq);
+        Put32(packet, journal[i].timestamp);
+        Put16(packet, journal[i].cmd.size());
+        packet.insert(packet.end(), journal[i].cmd.begin(), journal[i].cmd.end());
+    }
+
+    if (sendto(sock, packet.data(), packet.size(), 0, (const sockaddr*)&dest, sizeof(dest)) == -1)
+        std::cerr << "MIDIUdpOutDriver: datagram not sent" << std::endl;
+    num_packets++;
+
+    if (journal_depth > 0) {
+        journal.push_front(current);
+        if (journal.size() > journal_depth)
+            journal.pop_back();
+    }
+    current.cmd.clear();
+}
+
+
+void MIDIUdpOutDriver::HardwareMsgOut(const MIDIMessage &msg) {
+    if (sock == -1)
+        return;
+    TrackNotes(msg);
+
+    if (msg.IsSysEx()) {
+        const unsigned char* data = msg.GetSysEx()->GetBuffer();
+        unsigned int len = msg.GetSysEx()->GetLength();
+        // 10 is the max length of the two var len numbers
+        if (len <= MAX_CMD_LENGTH - 10) {
+            PutCmd(data, len);
+            num_messages++;
+            return;
+        }
+        // too long: split it into segments (every segment fills a datagram)
+        unsigned int start = (data[0] == SYSEX_START ? 1 : 0);
+        unsigned int end = (data[len - 1] == SYSEX_END ? len - 1 : len);
+        for (unsigned int pos = start; pos < end; ) {
+            unsigned int n = end - pos < MAX_CMD_LENGTH - 12 ? end - pos : MAX_CMD_LENGTH - 12;
+            segment.clear();
+            segment.push_back(pos == start ? SYSEX_START : SYSEX_END);
+            segment.insert(segment.end(), data + pos, data + pos + n);
+            pos += n;
+            segment.push_back(pos == end ? SYSEX_END : SYSEX_START);
+            PutCmd(segment.data(), segment.size());
+        }
+        num_messages++;
+    }
+    else if (msg.IsMetaEvent())
+        return;                     // don't send meta events
+    else if (msg.GetLength() > 0) {
+        unsigned char bytes[3] = { msg.GetStatus(), msg.GetByte1(), msg.GetByte2() };
+        PutCmd(bytes, msg.GetLength());
+        num_messages++;
+    }
+}
+
+
+void MIDIUdpOutDriver::PutCmd(const unsigned char* bytes, unsigned int len) {
+    // 10 is the max length of the two var len numbers
+    if (current.cmd.size() + len + 10 > MAX_CMD_LENGTH)
+        FlushOutput();
+    uint32_t now = (uint32_t)MIDITimer::GetSysTimeMs();
+    if (current.cmd.size() == 0)
+        current.timestamp = now;
+    PutVarLen(current.cmd, now - current.timestamp);
+    PutVarLen(current.cmd, len);
+    current.cmd.insert(current.cmd.end(), bytes, bytes + len);
+
+    if (auto_flush && !MIDITimer::IsOpen())     // no ticks will call FlushOutput()
+        FlushOutput();
+}
+
+
+/////////////////////////////////////////////////
+//            class MIDIUdpInDriver            //
+/////////////////////////////////////////////////
+
+
+MIDIUdpInDriver::MIDIUdpInDriver(int id, unsigned short p, unsigned int queue_size) :
+    MIDIInDriver(id, RtMidi::RTMIDI_DUMMY, queue_size), udp_port(p), sock(-1), receiving(false),
+    first_packet(true), expected_seq(0), in_sysex(false), num_packets(0), num_messages(0), num_lost(0),
+    num_recovered(0), latency_sum(0), max_latency(0) {
+}
+
+
+MIDIUdpInDriver::~MIDIUdpInDriver() {
+    StopReceiving();
+}
+
+
+void MIDIUdpInDriver::Reset() {
+    StopReceiving();
+    num_open = 0;
+    in_queue.Reset();
+    num_packets = num_messages = num_lost = num_recovered = 0;
+    latency_sum = max_latency = 0;
+
+    processor = 0;
+}
+
+
+std::string MIDIUdpInDriver::GetPortName() {
+    return "udp:" + std::to_string(udp_port);
+}
+
+
+void MIDIUdpInDriver::OpenPort() {
+    if (num_open == 0) {
+        sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock == -1) {
+            std::cerr << "MIDIUdpInDriver: cannot open socket" << std::endl;
+            return;
+        }
+        int yes = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        timeval tv;                     // the thread wakes periodically to check the receiving flag
+        tv.tv_sec = 0;
+        tv.tv_usec = 100000;
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(udp_port);
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(sock, (const sockaddr*)&addr, sizeof(addr)) == -1) {
+            std::cerr << "MIDIUdpInDriver: cannot bind UDP port " << udp_port << std::endl;
+            close(sock);
+            sock = -1;
+            return;
+        }
+        first_packet = true;
+        in_sysex = false;
+        receiving.store(true);
+        recv_thread = std::thread(ReceiveProc, this);
+    }
+    num_open++;
+
+    std::cout << "IN Port " << GetPortName() << " open";
+    if (num_open > 1)
+        std::cout << " (" << num_open << " times)";
+    std::cout<< std::endl;
+}
+
+
+void MIDIUdpInDriver::ClosePort() {
+    if (num_open == 1)
+        StopReceiving();
+    if (num_open > 0) {
+        num_open--;
+
+        std::cout << "IN Port " << GetPortName() << " closed";
+        if (num_open > 0)
+            std::cout << " (" << num_open << " times)";
+        std::cout << std::endl;
+    }
+    else
+        std::cout << "IN Port " << GetPortName()
+        << "Attempt to close an already closed port!" << std::endl;
+}
+
+
+void MIDIUdpInDriver::StopReceiving() {
+    receiving.store(false);
+    if (recv_thread.joinable())
+        recv_thread.join();
+    if (sock != -1) {
+        close(sock);
+        sock = -1;
+    }
+}
+
+
+void MIDIUdpInDriver::ReceiveProc(MIDIUdpInDriver* drv) {
+    std::vector<unsigned char> buf(65536);
+    while (drv->receiving.load()) {
+        ssize_t n = recv(drv->sock, buf.data(), buf.size(), 0);
+        if (n < (ssize_t)(UDP_HEADER_LENGTH + UDP_SECTION_HEADER_LENGTH))
+            continue;                               // timeout, error or too short
+        const unsigned char* p = buf.data();
+        if (p[0] != 'N' || p[1] != 'M' || p[2] != UDP_VERSION)
+            continue;
+
+        // finds the sections: sections[0] is the command section, the others the journal
+        unsigned int num_sections = p[3] + 1;
+        std::vector<unsigned int> sections;
+        unsigned int pos = UDP_HEADER_LENGTH;
+        while (sections.size() < num_sections && pos + UDP_SECTION_HEADER_LENGTH <= (unsigned int)n) {
+            unsigned int len = Get16(p + pos + 6);
+            if (pos + UDP_SECTION_HEADER_LENGTH + len > (unsigned int)n)
+                break;
+            sections.push_back(pos);
+            pos += UDP_SECTION_HEADER_LENGTH + len;
+        }
+        if (sections.size() == 0)
+            continue;
+        drv->num_packets++;
+
+        uint16_t seq = Get16(p + sections[0]);
+        if (drv->first_packet) {
+            drv->expected_seq = seq;
+            drv->first_packet = false;
+        }
+        int16_t gap = (int16_t)(seq - drv->expected_seq);
+        if (gap < 0)
+            continue;                               // an old or duplicate datagram
+        if (gap > 0) {                              // lost datagrams: look for them in the journal
+            drv->num_lost += gap;
+            for (uint16_t lost = drv->expected_seq; lost != seq; lost++) {
+                unsigned int i = 1;
+                for ( ; i < sections.size(); i++) {
+                    const unsigned char* sec = p + sections[i];
+                    if (Get16(sec) == lost) {
+                        drv->ParseCmd(sec + UDP_SECTION_HEADER_LENGTH, Get16(sec + 6), Get32(sec + 2));
+                        drv->num_recovered++;
+                        break;
+                    }
+                }
+                if (i == sections.size())
+                    drv->in_sysex = false;          // not recovered: drop the sysex we are joining
+            }
+        }
+        const unsigned char* sec = p + sections[0];
+        drv->ParseCmd(sec + UDP_SECTION_HEADER_LENGTH, Get16(sec + 6), Get32(sec + 2));
+        drv->expected_seq = seq + 1;
+    }
+}
+
+
+void MIDIUdpInDriver::ParseCmd(const unsigned char* cmd, unsigned int len, uint32_t timestamp) {
+    unsigned int pos = 0;
+    uint32_t delta, msg_len;
+    while (pos < len) {
+        if (!GetVarLen(cmd, len, pos, delta) || !GetVarLen(cmd, len, pos, msg_len) || pos + msg_len > len)
+            return;                                 // corrupted section
+        const unsigned char* bytes = cmd + pos;
+        pos += msg_len;
+        // the segments of a long sysex end with 0xF0 (but the last) or begin with 0xF7
+        if (msg_len >= 2 && (bytes[msg_len - 1] == SYSEX_START || bytes[0] == SYSEX_END)) {
+            if (bytes[0] == SYSEX_START) {          // the first segment
+                sysex_buf.assign(bytes, bytes + msg_len - 1);
+                in_sysex = true;
+            }
+            else if (in_sysex) {                    // a middle or the last segment
+                sysex_buf.insert(sysex_buf.end(), bytes + 1, bytes + msg_len - 1);
+                if (bytes[msg_len - 1] == SYSEX_END) {
+                    sysex_buf.push_back(SYSEX_END);
+                    in_sysex = false;
+                    PutMessage(sysex_buf.data(), sysex_buf.size(), timestamp + delta);
+                }
+            }
+            continue;                               // segments without their start are skipped
+        }
+        PutMessage(bytes, msg_len, timestamp + delta);
+    }
+}
+
+
+void MIDIUdpInDriver::PutMessage(const unsigned char* bytes, unsigned int len, uint32_t send_time) {
+    MIDITimedMessage msg;
+    if (!DecodeMessage(bytes, len, msg))
+        return;
+
+    tMsecs now = MIDITimer::GetSysTimeMs();
+    int32_t latency = (int32_t)((uint32_t)now - send_time);
+    if (latency >= 0) {
+        latency_sum += latency;
+        if ((unsigned long)latency > max_latency)
+            max_latency = latency;
+    }
+    num_messages++;
+
+    in_mutex.lock();
+    if (processor)
+        processor->Process(&msg);
+    in_queue.PutMessage(MIDIRawMessage(msg, now, port_id));
+    in_mutex.unlock();
+}
+
+#endif // WIN32
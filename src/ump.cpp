@@ -0,0 +1,129 @@
+/*
+ *   NiCMidi - A C++ Class Library for MIDI
+ *
+ *   Copyright (C) 2021, 2022  Nicola Cassetta
+ *   https://github.com/ncassetta/NiCMidi
+ *
+ *   This file is part of NiCMidi.
+ *
+ *   NiCMidi is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   NiCMidi is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with NiCMidi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "../include/ump.h"
+
+
+/////////////////////////////////////////////////
+//              struct MIDIUmp                 //
+/////////////////////////////////////////////////
+
+
+// Gets the sysex data of msg, without the 0xF0 and 0xF7 bytes (which are not stored in the packets).
+static const unsigned char* GetSysExData(const MIDIMessage& msg, unsigned int& len) {
+    const MIDISystemExclusive* sysex = msg.GetSysEx();
+    const unsigned char* data = sysex->GetBuffer();
+    len = sysex->GetLength();
+    if (len > 0 && data[0] == SYSEX_START) {
+        data++;
+        len--;
+    }
+    if (len > 0 && data[len - 1] == SYSEX_END)
+        len--;
+    return data;
+}
+
+
+unsigned int MIDIUmp::GetNumPackets(const MIDIMessage& msg) {
+    if (msg.GetStatus() < 0x80)                     // NoOp and other service messages
+        return 0;
+    if (msg.IsSysEx()) {
+        if (!msg.GetSysEx())
+            return 0;
+        unsigned int len;
+        GetSysExData(msg, len);
+        return len <= SYSEX_BYTES ? 1 : (len + SYSEX_BYTES - 1) / SYSEX_BYTES;
+    }
+    if (msg.GetStatus() == 0xff)                    // only a system reset, not a meta event
+        return (msg.GetByte1() == 0 && !msg.GetSysEx()) ? 1 : 0;
+    return 1;
+}
+
+
+MIDIUmp MIDIUmp::FromMessage(const MIDIMessage& msg, unsigned int n, unsigned char group) {
+    MIDIUmp ump;
+    if (msg.IsSysEx()) {
+        unsigned int len;
+        const unsigned char* data = GetSysExData(msg, len);
+        unsigned int num_packets = len <= SYSEX_BYTES ? 1 : (len + SYSEX_BYTES - 1) / SYSEX_BYTES;
+        unsigned int offs = n * SYSEX_BYTES;
+        unsigned int count = (len - offs < SYSEX_BYTES) ? len - offs : SYSEX_BYTES;
+        unsigned char bytes[SYSEX_BYTES] = { 0, 0, 0, 0, 0, 0 };
+        for (unsigned int i = 0; i < count; i++)
+            bytes[i] = data[offs + i];
+        uint32_t st = num_packets == 1 ? PACKET_COMPLETE :
+                      n == 0 ? PACKET_START :
+                      n == num_packets - 1 ? PACKET_END : PACKET_CONTINUE;
+        ump.words[0] = ((uint32_t)UMP_DATA64 << 28) | ((uint32_t)(group & 0x0f) << 24) | (st << 20) |
+                       ((uint32_t)count << 16) | ((uint32_t)bytes[0] << 8) | bytes[1];
+        ump.words[1] = ((uint32_t)bytes[2] << 24) | ((uint32_t)bytes[3] << 16) |
+                       ((uint32_t)bytes[4] << 8) | bytes[5];
+    }
+    else {
+        uint32_t type = msg.GetStatus() >= 0xf0 ? UMP_SYSTEM : UMP_MIDI1_CHANNEL;
+        ump.words[0] = (type << 28) | ((uint32_t)(group & 0x0f) << 24) | ((uint32_t)msg.GetStatus() << 16) |
+                       ((uint32_t)msg.GetByte1() << 8) | msg.GetByte2();
+        ump.words[1] = 0;
+    }
+    return ump;
+}
+
+
+bool MIDIUmp::ToMessage(MIDIMessage& msg) const {
+    switch (GetMessageType()) {
+        case UMP_SYSTEM:
+        case UMP_MIDI1_CHANNEL:
+            msg.Clear();
+            msg.SetStatus(GetStatus());
+            msg.SetByte1((words[0] >> 8) & 0xff);
+            msg.SetByte2(words[0] & 0xff);
+            return true;
+
+        case UMP_DATA64: {
+            unsigned char st = GetSysExStatus();
+            unsigned char len = GetSysExLength();
+            if (len > SYSEX_BYTES)
+                len = SYSEX_BYTES;
+            if (st == PACKET_COMPLETE || st == PACKET_START) {
+                msg.Clear();
+                msg.SetStatus(SYSEX_START);
+                msg.AllocateSysEx(st == PACKET_COMPLETE ? len + 2 : 4 * SYSEX_BYTES);
+                msg.EditSysEx()->PutEXC();
+            }
+            else if (!msg.IsSysEx() || !msg.GetSysEx())  // a packet without its start: skip it
+                return st == PACKET_END;
+            MIDISystemExclusive* sysex = msg.EditSysEx();
+            for (unsigned int i = 0; i < len; i++)
+                sysex->PutSysByte(GetSysExByte(i));
+            if (st == PACKET_COMPLETE || st == PACKET_END) {
+                sysex->PutEOX();
+                return true;
+            }
+            return false;
+        }
+
+        default:
+            msg.Clear();
+            return true;
+    }
+}